@@ -0,0 +1,190 @@
+#include "bcast.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define BCAST_SPIN 200
+
+static int spin_budget = -1;    // 0 on a uniprocessor, see handoff_init()
+
+bcast_t *bcast_attach(int create)
+{
+    int id = -1;
+
+    if (spin_budget < 0)
+        spin_budget = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? BCAST_SPIN : 0;
+
+    if (create) {
+        // 只有一個 writer：上一輪留下來的直接砍掉，保證從全 0 開始
+        bcast_remove();
+        id = shmget(BCAST_KEY, sizeof(bcast_t), 0666 | IPC_CREAT | IPC_EXCL);
+    } else {
+        for (int i = 0; i <= 50 && id == -1; ++i) {
+            id = shmget(BCAST_KEY, 0, 0666);
+            if (id == -1 && errno != ENOENT)
+                break;
+            if (id == -1)
+                usleep(20 * 1000);
+        }
+    }
+    if (id == -1) {
+        perror("shmget(bcast)");
+        return NULL;
+    }
+
+    bcast_t *b = (bcast_t *)shmat(id, NULL, 0);
+    if (b == (bcast_t *)-1) {
+        perror("shmat(bcast)");
+        return NULL;
+    }
+
+    if (create) {
+        // 全 0 的 segment 已經是空的 log（seq 0 不會等於任何 2 * pos + 2）
+        b->shm_id = id;
+        atomic_store_explicit(&b->ready, 1, memory_order_release);
+    } else {
+        for (int i = 0; i <= 50 && !atomic_load_explicit(&b->ready, memory_order_acquire); ++i)
+            usleep(20 * 1000);
+        if (!atomic_load_explicit(&b->ready, memory_order_acquire)) {
+            fprintf(stderr, "broadcast log was never initialised\n");
+            shmdt(b);
+            return NULL;
+        }
+    }
+    return b;
+}
+
+void bcast_remove(void)
+{
+    int id = shmget(BCAST_KEY, 0, 0666);
+    if (id != -1)
+        shmctl(id, IPC_RMID, NULL);
+}
+
+void bcast_release(bcast_t *b)
+{
+    shmctl(b->shm_id, IPC_RMID, NULL);
+}
+
+static void wake_readers(bcast_t *b)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&b->data_waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&b->data_evt, 1);
+        futex_wake(&b->data_evt, INT_MAX);
+    }
+}
+
+void bcast_append(bcast_t *b, const void *buf, size_t len)
+{
+    uint64_t pos = atomic_load_explicit(&b->head, memory_order_relaxed);
+    __typeof__(b->slots[0]) *slot = &b->slots[pos & (BCAST_SLOTS - 1)];
+
+    if (len > BCAST_SLOT_DATA)
+        len = BCAST_SLOT_DATA;
+
+    // seq 變奇數 = 寫到一半；reader 讀完發現 seq 變了就知道被蓋掉
+    atomic_store_explicit(&slot->seq, 2 * pos + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->len = (uint32_t)len;
+    memcpy(slot->data, buf, len);
+    atomic_store_explicit(&slot->seq, 2 * pos + 2, memory_order_release);
+
+    atomic_store_explicit(&b->head, pos + 1, memory_order_release);
+    wake_readers(b);
+}
+
+void bcast_finish(bcast_t *b)
+{
+    atomic_store(&b->done, 1);
+    // 叫醒所有睡著的 reader，讓它們自己檢查是不是讀完了
+    atomic_fetch_add(&b->data_evt, 1);
+    futex_wake(&b->data_evt, INT_MAX);
+}
+
+void bcast_cursor_init(bcast_cursor_t *c, bcast_t *b)
+{
+    uint64_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+    c->log = b;
+    c->pos = head > BCAST_SLOTS / 2 ? head - BCAST_SLOTS / 2 : 0;
+    c->lost = c->laps = 0;
+}
+
+/* 被 writer 追過：跳到 head 後面半圈的地方，中間的都算 lost */
+static void skip_ahead(bcast_cursor_t *c, uint64_t head)
+{
+    uint64_t to = head - BCAST_SLOTS / 2;
+    if (to <= c->pos)
+        return;
+    c->lost += to - c->pos;
+    c->laps++;
+    atomic_fetch_add_explicit(&c->log->lost_total, to - c->pos, memory_order_relaxed);
+    c->pos = to;
+}
+
+static size_t try_read(bcast_cursor_t *c, void *buf, size_t cap)
+{
+    bcast_t *b = c->log;
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+        if (c->pos == head)
+            return 0;
+        if (head - c->pos >= BCAST_SLOTS) {
+            skip_ahead(c, head);
+            continue;
+        }
+
+        __typeof__(b->slots[0]) *slot = &b->slots[c->pos & (BCAST_SLOTS - 1)];
+        uint64_t want = 2 * c->pos + 2;
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != want) {
+            // pos < head，所以這格一定寫完過：seq 不對就是又被下一圈蓋掉了
+            skip_ahead(c, atomic_load_explicit(&b->head, memory_order_acquire));
+            continue;
+        }
+        size_t len = slot->len;
+        if (len > BCAST_SLOT_DATA)
+            len = BCAST_SLOT_DATA;
+        if (len > cap)
+            len = cap;
+        memcpy(buf, slot->data, len);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != want)
+            continue;   // copy 的時候被蓋掉，buf 裡的東西不能用
+
+        c->pos++;
+        return len;
+    }
+}
+
+size_t bcast_read(bcast_cursor_t *c, void *buf, size_t cap)
+{
+    bcast_t *b = c->log;
+    size_t len;
+    for (;;) {
+        for (int i = 0; i < spin_budget; ++i) {
+            if ((len = try_read(c, buf, cap)) > 0)
+                return len;
+            cpu_relax();
+        }
+
+        // 先記下 event 值並登記，再試一次；之後 writer 有 append 的話 futex_wait 會直接返回
+        int e = atomic_load(&b->data_evt);
+        atomic_fetch_add(&b->data_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ((len = try_read(c, buf, cap)) > 0) {
+            atomic_fetch_sub(&b->data_waiters, 1);
+            return len;
+        }
+        if (atomic_load(&b->done)) {
+            // writer 結束了：它最後的 append 一定看得到，再試最後一次
+            atomic_fetch_sub(&b->data_waiters, 1);
+            return try_read(c, buf, cap);
+        }
+        futex_wait(&b->data_evt, e);
+        atomic_fetch_sub(&b->data_waiters, 1);
+    }
+}
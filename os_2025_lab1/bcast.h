@@ -0,0 +1,74 @@
+#ifndef BCAST_H
+#define BCAST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "ring.h"
+
+#define BCAST_KEY       0x66C0DE
+#define BCAST_SLOTS     4096    // must be a power of two
+#define BCAST_SLOT_DATA RING_SLOT_DATA
+
+/*
+ * Single-writer broadcast log in a System V shm segment. The writer appends
+ * at `head` and never waits for anybody; every reader keeps its own cursor.
+ *
+ * Each slot is a seqlock: while record pos is being copied in, the slot's
+ * seq is 2 * pos + 1, afterwards 2 * pos + 2. A reader copies the slot out
+ * and then re-checks seq; if it changed (or was already past 2 * pos + 2)
+ * the writer has lapped the reader, which then skips ahead and counts the
+ * records it missed in `lost`.
+ *
+ * Lifetime: the writer sets `done` after its last record. The segment is
+ * removed by whoever detaches last (the readers count themselves in
+ * `readers`), by its id: a newer log may already sit under BCAST_KEY.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t head;     // records published so far
+
+    _Alignas(CACHE_LINE) _Atomic int ready;
+    int shm_id;                                     // this segment, set by the writer
+    _Atomic int done;
+    _Atomic int readers;                            // attached readers
+    _Atomic uint64_t lost_total;                    // records skipped by all readers
+
+    // futex event counter, bumped on append when a reader sleeps on it
+    _Alignas(CACHE_LINE) _Atomic int data_evt;
+    _Atomic int data_waiters;
+
+    _Alignas(CACHE_LINE) struct {
+        _Atomic uint64_t seq;
+        uint32_t len;
+        char data[BCAST_SLOT_DATA];
+    } slots[BCAST_SLOTS];
+} bcast_t;
+
+// One reader's position in the log.
+typedef struct {
+    bcast_t *log;
+    uint64_t pos;       // next record to read
+    uint64_t lost;      // records overwritten before we got to them
+    uint64_t laps;      // times we were lapped
+} bcast_cursor_t;
+
+/*
+ * Writer: create (or re-initialise) the segment. Reader (create == 0): wait
+ * up to ~1s for a writer to create it. Returns NULL on failure.
+ */
+bcast_t *bcast_attach(int create);
+void bcast_remove(void);
+// Mark the segment b is in for removal.
+void bcast_release(bcast_t *b);
+
+// Never blocks; overwrites the oldest record once the log is full.
+void bcast_append(bcast_t *b, const void *buf, size_t len);
+void bcast_finish(bcast_t *b);
+
+// A new reader starts half a log behind the writer (at record 0 if the writer has just started).
+void bcast_cursor_init(bcast_cursor_t *c, bcast_t *b);
+
+// Blocks while nothing new is published; returns 0 once the writer is done and everything is read.
+size_t bcast_read(bcast_cursor_t *c, void *buf, size_t cap);
+
+#endif
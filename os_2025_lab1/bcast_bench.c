@@ -0,0 +1,88 @@
+/*
+ * Run one mode 9 sender against R receivers on the broadcast log and report
+ * the throughput for every R:
+ *
+ *   ./bcast_bench [-r 1,4,16] [input.txt]
+ *
+ * Every receiver reads the whole stream, so one run delivers R * frames
+ * messages. The writer never waits for slow receivers; records they were
+ * lapped on show up in the "lost" column instead.
+ * Children's stdout goes to /dev/null and receivers run with -q.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/shm.h>
+#include "bcast.h"
+#include "bench.h"
+
+#define MAX_RUNS 64
+
+static double run_once(int n_readers, const char *input, uint64_t *lost)
+{
+    char readers_arg[16];
+    snprintf(readers_arg, sizeof(readers_arg), "%d", n_readers);
+
+    bcast_remove();
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+
+    // sender 建 log 並等 R 個 receiver 接上才開始寫
+    char *sargv[] = { "./sender", "-R", readers_arg, "9", (char *)input, NULL };
+    bench_launch(sargv);
+
+    // 自己也 attach（不算 reader），segment 被最後一個 receiver 刪掉後還能讀 lost_total
+    bcast_t *log = bcast_attach(0);
+    if (!log)
+        exit(1);
+    for (int i = 0; i < n_readers; ++i) {
+        char *argv[] = { "./receiver", "-q", "9", NULL };
+        bench_launch(argv);
+    }
+
+    int failed = 0, status;
+    while (wait(&status) > 0)
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    *lost = atomic_load(&log->lost_total);
+    shmdt(log);
+    bcast_remove();
+
+    if (failed)
+        fprintf(stderr, "[bcast_bench] a child failed for R=%d\n", n_readers);
+    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    int readers[MAX_RUNS] = { 1, 4, 16 }, n_runs = 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+        case 'r': n_runs = bench_parse_list(optarg, readers, MAX_RUNS); break;
+        default:
+            fprintf(stderr, "Usage: ./bcast_bench [-r 1,4,16] [input.txt]\n");
+            return 1;
+        }
+    }
+    const char *input = optind < argc ? argv[optind] : "input.txt";
+    size_t frames = bench_count_frames(input);
+
+    printf("%9s %12s %10s %14s %14s %10s\n",
+           "receivers", "messages", "seconds", "msg/s/reader", "msg/s total", "lost");
+    for (int i = 0; i < n_runs; ++i) {
+        uint64_t lost;
+        double sec = run_once(readers[i], input, &lost);
+        size_t total = frames * readers[i] - lost;
+        printf("%9d %12zu %10.4f %14.0f %14.0f %10lu\n",
+               readers[i], total, sec, total / readers[i] / sec, total / sec, (unsigned long)lost);
+    }
+    return 0;
+}
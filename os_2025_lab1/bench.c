@@ -0,0 +1,54 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int bench_parse_list(const char *s, int *out, int max)
+{
+    int n = 0;
+    char *copy = strdup(s);
+    for (char *tok = strtok(copy, ","); tok && n < max; tok = strtok(NULL, ","))
+        out[n++] = atoi(tok);
+    free(copy);
+    return n;
+}
+
+size_t bench_count_frames(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    char *line = NULL;
+    size_t cap = 0, frames = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, fp)) != -1)
+        frames += n > 1024 ? (n + 1023) / 1024 : 1;
+    free(line);
+    fclose(fp);
+    return frames;
+}
+
+pid_t bench_launch(char *const argv[])
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        // 終端機不能變成瓶頸
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    return pid;
+}
@@ -0,0 +1,21 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Helpers shared by the drivers that launch ./sender and ./receiver
+ * processes and time them (mpmc_bench, bcast_bench, chan_bench).
+ */
+
+// "1,2,4" -> out[0..n); returns n (at most max).
+int bench_parse_list(const char *s, int *out, int max);
+
+// Frames one sender produces for this input: lines longer than 1024 bytes take several.
+size_t bench_count_frames(const char *path);
+
+// fork + execv(argv[0]) with stdout on /dev/null; exits on fork failure.
+pid_t bench_launch(char *const argv[]);
+
+#endif
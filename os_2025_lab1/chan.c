@@ -0,0 +1,164 @@
+#include "chan.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+static chan_dir_t *attach_dir(void)
+{
+    int created = 0, id;
+    // 最後一個 channel 關掉時會 IPC_RMID：EEXIST 之後再 shmget 可能拿到 ENOENT，重新建一次
+    do {
+        id = shmget(CHAN_KEY, sizeof(chan_dir_t), 0666 | IPC_CREAT | IPC_EXCL);
+        if (id != -1)
+            created = 1;
+        else if (errno == EEXIST)
+            id = shmget(CHAN_KEY, sizeof(chan_dir_t), 0666);
+    } while (id == -1 && errno == ENOENT);
+    if (id == -1) {
+        perror("shmget(chan)");
+        return NULL;
+    }
+
+    chan_dir_t *dir = (chan_dir_t *)shmat(id, NULL, 0);
+    if (dir == (chan_dir_t *)-1) {
+        perror("shmat(chan)");
+        return NULL;
+    }
+
+    if (created) {
+        // 拿著 lock 的 process 死掉時，下一個人會拿到 EOWNERDEAD 而不是卡住
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&dir->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        atomic_store_explicit(&dir->ready, 1, memory_order_release);
+    } else {
+        for (int i = 0; i <= 50 && !atomic_load_explicit(&dir->ready, memory_order_acquire); ++i)
+            usleep(20 * 1000);
+        if (!atomic_load_explicit(&dir->ready, memory_order_acquire)) {
+            fprintf(stderr, "channel directory was never initialised\n");
+            shmdt(dir);
+            return NULL;
+        }
+    }
+    return dir;
+}
+
+static void lock_dir(chan_dir_t *dir)
+{
+    if (pthread_mutex_lock(&dir->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&dir->lock);   // 目錄只在 lock 裡改，改到一半也還是合法的
+}
+
+static int is_gone(pid_t pid)
+{
+    return pid != 0 && kill(pid, 0) == -1 && errno == ESRCH;
+}
+
+static int is_idle(const chan_t *ch)
+{
+    return !ch->sender && !ch->receiver &&
+           atomic_load(&ch->ring.head) == atomic_load(&ch->ring.tail);
+}
+
+/* 把已經結束的 process 從 channel 上拿掉，順便回收沒人用的 channel */
+static void reap(chan_dir_t *dir)
+{
+    for (int i = 0; i < CHAN_MAX; ++i) {
+        chan_t *ch = &dir->chans[i];
+        if (!ch->in_use)
+            continue;
+        if (is_gone(ch->sender))
+            ch->sender = 0;
+        if (is_gone(ch->receiver))
+            ch->receiver = 0;
+        if (is_idle(ch))
+            ch->in_use = 0;
+    }
+}
+
+chan_t *chan_open(const char *name, int role, chan_dir_t **dirp)
+{
+    if (strlen(name) >= CHAN_NAME) {
+        fprintf(stderr, "channel name too long (max %d bytes): %s\n", CHAN_NAME - 1, name);
+        return NULL;
+    }
+
+    chan_dir_t *dir;
+    for (;;) {
+        if (!(dir = attach_dir()))
+            return NULL;
+        lock_dir(dir);
+        if (!dir->dead)
+            break;
+        // 剛好被最後一個離開的人刪掉了：重新 attach（會建一塊新的）
+        pthread_mutex_unlock(&dir->lock);
+        shmdt(dir);
+    }
+    reap(dir);
+
+    chan_t *ch = NULL, *free_ch = NULL;
+    for (int i = 0; i < CHAN_MAX && !ch; ++i) {
+        if (dir->chans[i].in_use && strcmp(dir->chans[i].name, name) == 0)
+            ch = &dir->chans[i];
+        else if (!dir->chans[i].in_use && !free_ch)
+            free_ch = &dir->chans[i];
+    }
+    if (!ch && free_ch) {
+        // slot 內容不用清，ring 的 index 跟 futex word 歸零就是空的
+        ch = free_ch;
+        memset(ch, 0, offsetof(chan_t, ring) + offsetof(ring_t, slots));
+        strcpy(ch->name, name);
+        ch->in_use = 1;
+    }
+    if (!ch) {
+        fprintf(stderr, "channel directory is full (%d channels)\n", CHAN_MAX);
+        pthread_mutex_unlock(&dir->lock);
+        shmdt(dir);
+        return NULL;
+    }
+
+    pid_t *end = role == 0 ? &ch->sender : &ch->receiver;
+    if (*end) {
+        fprintf(stderr, "channel %s already has a %s (pid %d)\n",
+                name, role == 0 ? "sender" : "receiver", (int)*end);
+        pthread_mutex_unlock(&dir->lock);
+        shmdt(dir);
+        return NULL;
+    }
+    *end = getpid();
+    pthread_mutex_unlock(&dir->lock);
+
+    *dirp = dir;
+    return ch;
+}
+
+void chan_close(chan_dir_t *dir, chan_t *ch, int role)
+{
+    lock_dir(dir);
+    if (role == 0)
+        ch->sender = 0;
+    else
+        ch->receiver = 0;
+    // sender 先走的時候 ring 裡可能還有東西，留給 receiver 讀完再回收
+    if (is_idle(ch))
+        ch->in_use = 0;
+
+    int any = 0;
+    for (int i = 0; i < CHAN_MAX && !any; ++i)
+        any = dir->chans[i].in_use;
+    if (!any) {
+        dir->dead = 1;
+        int id = shmget(CHAN_KEY, 0, 0666);
+        if (id != -1)
+            shmctl(id, IPC_RMID, NULL);
+    }
+    pthread_mutex_unlock(&dir->lock);
+    shmdt(dir);
+}
@@ -0,0 +1,53 @@
+#ifndef CHAN_H
+#define CHAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "ring.h"
+
+#define CHAN_KEY    0x77C0DE
+#define CHAN_MAX    64          // channels in the directory
+#define CHAN_NAME   32          // including the terminating NUL
+
+/*
+ * One named channel: an SPSC ring plus the two futex words its sides park
+ * on. A channel is in use while it has a sender or a receiver attached, or
+ * while it still holds frames nobody has read.
+ */
+typedef struct {
+    char name[CHAN_NAME];
+    int in_use;                 // guarded by the directory lock
+    pid_t sender, receiver;     // attached endpoints, 0 if none
+    futex_sem_t space, data;    // ring_push()/ring_pop() handoffs
+    ring_t ring;
+} chan_t;
+
+/*
+ * Channel directory at the start of a single System V shm segment
+ * (CHAN_KEY). Processes attach by channel name, so any number of
+ * sender/receiver pairs can run side by side without their own keys or
+ * semaphore names. The robust process-shared mutex is only taken to open
+ * and close channels; the rings themselves are lock-free.
+ *
+ * The segment is removed when its last channel is released; `dead` tells a
+ * process that attached just before that to attach again.
+ */
+typedef struct {
+    _Atomic int ready;
+    pthread_mutex_t lock;
+    int dead;
+    chan_t chans[CHAN_MAX];
+} chan_dir_t;
+
+/*
+ * Attach to the directory (creating it if needed) and claim the sender
+ * (role 0) or receiver (role 1) end of channel `name`, allocating the
+ * channel if nobody uses that name yet. Returns NULL on failure.
+ */
+chan_t *chan_open(const char *name, int role, chan_dir_t **dir);
+void chan_close(chan_dir_t *dir, chan_t *ch, int role);
+
+#endif
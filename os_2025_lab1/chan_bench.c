@@ -0,0 +1,76 @@
+/*
+ * Run K independent sender/receiver pairs, each on its own mode 10 channel
+ * in the shared directory, and report the aggregate throughput for every K:
+ *
+ *   ./chan_bench [-k 1,2,4,8,16,32] [input.txt]
+ *
+ * Pair i uses channel "bench<i>"; every sender sends the whole input, so
+ * one run moves K * frames messages. Children's stdout goes to /dev/null
+ * and receivers run with -q.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include "chan.h"
+#include "bench.h"
+
+#define MAX_RUNS 64
+
+static double run_once(int n_chans, const char *input)
+{
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+
+    // 哪一邊先 open 都可以：第一個 open 的會把 channel 建起來
+    for (int i = 0; i < n_chans; ++i) {
+        char name[CHAN_NAME];
+        snprintf(name, sizeof(name), "bench%d", i);
+        char *sargv[] = { "./sender", "-C", name, "10", (char *)input, NULL };
+        char *rargv[] = { "./receiver", "-q", "-C", name, "10", NULL };
+        bench_launch(sargv);
+        bench_launch(rargv);
+    }
+
+    int failed = 0, status;
+    while (wait(&status) > 0)
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    if (failed)
+        fprintf(stderr, "[chan_bench] a child failed for K=%d\n", n_chans);
+    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    int chans[MAX_RUNS] = { 1, 2, 4, 8, 16, 32 }, n_runs = 6;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:")) != -1) {
+        switch (opt) {
+        case 'k': n_runs = bench_parse_list(optarg, chans, MAX_RUNS); break;
+        default:
+            fprintf(stderr, "Usage: ./chan_bench [-k 1,2,4,8,16,32] [input.txt]\n");
+            return 1;
+        }
+    }
+    const char *input = optind < argc ? argv[optind] : "input.txt";
+    size_t frames = bench_count_frames(input);
+
+    printf("%9s %12s %10s %14s %14s\n", "channels", "messages", "seconds", "msg/s/channel", "msg/s total");
+    for (int i = 0; i < n_runs; ++i) {
+        if (chans[i] > CHAN_MAX) {
+            fprintf(stderr, "[chan_bench] at most %d channels\n", CHAN_MAX);
+            continue;
+        }
+        double sec = run_once(chans[i], input);
+        size_t total = frames * chans[i];
+        printf("%9d %12zu %10.4f %14.0f %14.0f\n", chans[i], total, sec, total / chans[i] / sec, total / sec);
+    }
+    return 0;
+}
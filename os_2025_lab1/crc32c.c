@@ -0,0 +1,55 @@
+#include "crc32c.h"
+#include <string.h>
+
+#define POLY 0x82f63b78u    // reflected Castagnoli polynomial
+
+static uint32_t table[256];
+
+static uint32_t crc_table(uint32_t crc, const unsigned char *p, size_t n)
+{
+    while (n--)
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(uint32_t crc, const unsigned char *p, size_t n)
+{
+    uint64_t c = crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __builtin_ia32_crc32di(c, v);
+    }
+    crc = (uint32_t)c;
+    while (n--)
+        crc = __builtin_ia32_crc32qi(crc, *p++);
+    return crc;
+}
+#endif
+
+static uint32_t crc_init(uint32_t crc, const unsigned char *p, size_t n);
+static uint32_t (*crc_impl)(uint32_t, const unsigned char *, size_t) = crc_init;
+
+/* 第一次呼叫時才決定用哪個版本（硬體指令 or 查表） */
+static uint32_t crc_init(uint32_t crc, const unsigned char *p, size_t n)
+{
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c >> 1) ^ (c & 1 ? POLY : 0);
+        table[i] = c;
+    }
+    crc_impl = crc_table;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2"))
+        crc_impl = crc_sse42;
+#endif
+    return crc_impl(crc, p, n);
+}
+
+uint32_t crc32c(const void *buf, size_t n)
+{
+    return ~crc_impl(~0u, buf, n);
+}
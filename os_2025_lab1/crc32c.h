@@ -0,0 +1,14 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CRC32C (Castagnoli) of buf[0, n). Uses the SSE4.2 crc32 instruction when
+ * the CPU has it and a byte-wise table otherwise; both give the same value
+ * (crc32c("123456789") == 0xe3069283).
+ */
+uint32_t crc32c(const void *buf, size_t n);
+
+#endif
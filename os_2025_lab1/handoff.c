@@ -0,0 +1,201 @@
+#define _GNU_SOURCE   // sched_setaffinity
+#include "handoff.h"
+#include "hist.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// 不能用 FUTEX_PRIVATE_FLAG：等待的是另一個 process
+long futex_wait(_Atomic int *addr, int expected)
+{
+    return syscall(SYS_futex, (int *)addr, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+long futex_wake(_Atomic int *addr, int n)
+{
+    return syscall(SYS_futex, (int *)addr, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+
+static inline int try_take(futex_sem_t *fs)
+{
+    int c = atomic_load_explicit(&fs->count, memory_order_relaxed);
+    while (c > 0) {
+        if (atomic_compare_exchange_weak_explicit(&fs->count, &c, c - 1,
+                                                  memory_order_acquire,
+                                                  memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+static void futex_sem_wait(handoff_t *h)
+{
+    futex_sem_t *fs = h->fx;
+
+    // 跟 glibc adaptive mutex 類似：上次大概等多久就 spin 多久，失敗就縮小
+    int budget = 2 * h->spin_est + 10;
+    if (budget > h->spin)
+        budget = h->spin;
+    for (int i = 0; i < budget; ++i) {
+        if (try_take(fs)) {
+            h->spin_est += (i - h->spin_est) / 8;
+            return;
+        }
+        cpu_relax();
+    }
+    h->spin_est /= 2;
+
+    // 先登記自己要睡，post() 看到 waiters 才會 FUTEX_WAKE；只有這條慢路徑才讀時鐘
+    uint64_t t0 = now_ns();
+    atomic_fetch_add(&fs->waiters, 1);
+    while (!try_take(fs)) {
+        h->sleeps++;
+        // count 還是 0 才睡；中間被 post 過的話 kernel 直接回 EAGAIN
+        if (futex_wait(&fs->count, 0) == -1 && errno != EAGAIN && errno != EINTR) {
+            perror("futex(FUTEX_WAIT)");
+            exit(1);
+        }
+    }
+    atomic_fetch_sub(&fs->waiters, 1);
+    h->blocked_ns += now_ns() - t0;
+}
+
+static void futex_sem_post(handoff_t *h, int n)
+{
+    futex_sem_t *fs = h->fx;
+
+    atomic_fetch_add(&fs->count, n);
+    if (atomic_load(&fs->waiters) > 0) {
+        h->wakes++;
+        if (futex_wake(&fs->count, n) == -1) {
+            perror("futex(FUTEX_WAKE)");
+            exit(1);
+        }
+    }
+}
+
+void handoff_init(handoff_t *h, sem_t *sem, futex_sem_t *fx)
+{
+    memset(h, 0, sizeof(*h));
+    h->sem = sem;
+    h->fx = fx;
+    h->efd = -1;
+    // 只有一顆 CPU 時對方不可能在我們 spin 的時候跑，spin 只是浪費 time slice
+    h->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? HANDOFF_SPIN : 0;
+    h->spin_est = h->spin / 4;
+}
+
+void handoff_init_eventfd(handoff_t *h, int efd)
+{
+    handoff_init(h, NULL, NULL);
+    h->efd = efd;
+}
+
+/* --busy-poll：一直 pause 直到拿到 post，不睡也不進 kernel（eventfd 只能 read，不適用） */
+static int busy_take(handoff_t *h)
+{
+    for (long i = 0; h->busy < 0 || i < h->busy; ++i) {
+        if (h->fx ? try_take(h->fx) : h->sem ? sem_trywait(h->sem) == 0 : 0)
+            return 1;
+        if (h->efd >= 0)
+            return 0;
+        cpu_relax();
+    }
+    return 0;
+}
+
+void handoff_wait(handoff_t *h)
+{
+    h->waits++;
+    if (h->busy && busy_take(h))
+        return;
+    if (h->fx) {
+        futex_sem_wait(h);
+        return;
+    }
+    if (h->efd >= 0) {
+        // counter 是 0 就會睡在 read() 裡，每次 read 只拿走 1
+        uint64_t v, t0 = now_ns();
+        h->sleeps++;
+        while (read(h->efd, &v, sizeof(v)) != sizeof(v)) {
+            if (errno != EINTR) {
+                perror("read(eventfd)");
+                exit(1);
+            }
+        }
+        h->blocked_ns += now_ns() - t0;
+        return;
+    }
+
+    if (sem_trywait(h->sem) == 0)
+        return;
+    uint64_t t0 = now_ns();
+    h->sleeps++;
+    while (sem_wait(h->sem) == -1) {
+        if (errno != EINTR) {
+            perror("sem_wait");
+            exit(1);
+        }
+    }
+    h->blocked_ns += now_ns() - t0;
+}
+
+void handoff_post(handoff_t *h)
+{
+    handoff_post_n(h, 1);
+}
+
+void handoff_post_n(handoff_t *h, int n)
+{
+    if (h->fx) {
+        futex_sem_post(h, n);
+        return;
+    }
+    if (h->efd >= 0) {
+        uint64_t v = n;
+        h->wakes++;
+        if (write(h->efd, &v, sizeof(v)) != sizeof(v)) {
+            perror("write(eventfd)");
+            exit(1);
+        }
+        return;
+    }
+
+    // POSIX semaphore 沒有一次加 n 的介面；沒人在等的話 sem_post 不會進 kernel
+    h->wakes++;
+    while (n-- > 0) {
+        if (sem_post(h->sem) == -1) {
+            perror("sem_post");
+            exit(1);
+        }
+    }
+}
+
+int pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+        perror("sched_setaffinity");
+        return -1;
+    }
+    return 0;
+}
+
+void handoff_report(int sync, const handoff_t *tx, const handoff_t *rx)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("handoff(%s): %lu waits, %lu blocked (%.6f s), %lu wakes; context switches: %ld voluntary, %ld involuntary\n",
+           sync == SYNC_FUTEX ? "futex" : sync == SYNC_EVENTFD ? "eventfd" : "sem",
+           tx->waits + rx->waits, tx->sleeps + rx->sleeps,
+           (tx->blocked_ns + rx->blocked_ns) * 1e-9, tx->wakes + rx->wakes,
+           ru.ru_nvcsw, ru.ru_nivcsw);
+}
@@ -0,0 +1,79 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+
+#define SYNC_SEM    0   // named POSIX semaphores (/tx_sem, /rx_sem)
+#define SYNC_FUTEX  1   // futex words inside the control segment
+#define SYNC_EVENTFD 2  // EFD_SEMAPHORE eventfds passed over a unix socket (mode 8)
+
+#define HANDOFF_SPIN 1000   // upper bound on pause iterations before FUTEX_WAIT
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Raw shared (non-private) futex calls; wait returns early if *addr != expected.
+long futex_wait(_Atomic int *addr, int expected);
+long futex_wake(_Atomic int *addr, int n);
+
+/*
+ * Counting semaphore on a shared futex word. post() only enters the kernel
+ * when somebody is registered in `waiters`; wait() spins for a while before
+ * registering itself and calling FUTEX_WAIT.
+ */
+typedef struct {
+    _Atomic int count;
+    _Atomic int waiters;
+} futex_sem_t;
+
+/*
+ * Control page shared by sender and receiver (CTL_KEY). The sender fills it
+ * in and sets `ready` last; the receiver follows whatever `sync` says.
+ */
+typedef struct {
+    _Atomic int ready;
+    int sync;                   // SYNC_SEM or SYNC_FUTEX
+    futex_sem_t tx, rx;         // same roles as sem_tx / sem_rx
+    _Atomic int mapped;         // zero-copy: receiver has mmapped the published input
+    int window;                 // credits (tx starts at this), see sender -w
+} ctl_t;
+
+// One side of a handoff: a named semaphore, a futex_sem_t or an eventfd.
+typedef struct {
+    sem_t *sem;
+    futex_sem_t *fx;
+    int efd;                              // -1 unless set up by handoff_init_eventfd()
+    int spin;                             // spin budget cap (0 on a uniprocessor)
+    int spin_est;                         // adaptive estimate of how long the peer takes
+    long busy;                            // --busy-poll: spins before the normal wait (-1: never block)
+    unsigned long waits, sleeps, wakes;   // calls, FUTEX_WAIT/sem_wait blocks, FUTEX_WAKEs
+    uint64_t blocked_ns;                  // time spent asleep in those blocks
+} handoff_t;
+
+// Exactly one of sem / fx is non-NULL (both NULL only via handoff_init_eventfd).
+void handoff_init(handoff_t *h, sem_t *sem, futex_sem_t *fx);
+// efd must be an EFD_SEMAPHORE eventfd: every read() takes exactly one post.
+void handoff_init_eventfd(handoff_t *h, int efd);
+void handoff_wait(handoff_t *h);
+void handoff_post(handoff_t *h);
+// Post n at once (returning a batch of credits): one FUTEX_WAKE / eventfd write.
+void handoff_post_n(handoff_t *h, int n);
+
+/*
+ * Busy polling only pays off when both sides own a CPU: pin the calling
+ * thread to `cpu` (threads created later inherit it). Returns 0 or -1.
+ */
+int pin_to_cpu(int cpu);
+
+// One-line summary of blocking/wakeup counts plus this process's context switches.
+void handoff_report(int sync, const handoff_t *tx, const handoff_t *rx);
+
+#endif
@@ -0,0 +1,97 @@
+#include "hist.h"
+#include <string.h>
+
+static const double report_pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+static const char *report_names[] = { "p50", "p90", "p99", "p99.9" };
+#define N_REPORT (sizeof(report_pcts) / sizeof(report_pcts[0]))
+
+static inline int bucket_of(uint64_t v)
+{
+    if (v < HIST_SUB)
+        return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HIST_SUB_BITS;
+    // 取最高的 HIST_SUB_BITS+1 個 bit：指數決定第幾段，後面幾個 bit 決定段內位置
+    return (shift + 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+}
+
+// Largest value that still falls into bucket b.
+static inline uint64_t bucket_top(int b)
+{
+    if (b < HIST_SUB)
+        return (uint64_t)b;
+    int shift = b / HIST_SUB - 1;
+    uint64_t m = HIST_SUB + (uint64_t)(b % HIST_SUB);
+    return ((m + 1) << shift) - 1;
+}
+
+void hist_init(hist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_record(hist_t *h, uint64_t value)
+{
+    h->counts[bucket_of(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+uint64_t hist_percentile(const hist_t *h, double p)
+{
+    if (h->total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            uint64_t v = bucket_top(b);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static void print_ns(FILE *out, uint64_t ns)
+{
+    if (ns < 10000)
+        fprintf(out, "%luns", (unsigned long)ns);
+    else if (ns < 10000000)
+        fprintf(out, "%.1fus", ns / 1e3);
+    else
+        fprintf(out, "%.1fms", ns / 1e6);
+}
+
+void hist_print(FILE *out, const char *name, const hist_t *h)
+{
+    fprintf(out, "%s (n=%lu):", name, (unsigned long)h->total);
+    if (h->total == 0) {
+        fprintf(out, " no samples\n");
+        return;
+    }
+    for (size_t i = 0; i < N_REPORT; ++i) {
+        fprintf(out, " %s=", report_names[i]);
+        print_ns(out, hist_percentile(h, report_pcts[i]));
+    }
+    fprintf(out, " max=");
+    print_ns(out, h->max);
+    fprintf(out, " mean=");
+    print_ns(out, (uint64_t)(h->sum / h->total));
+    fprintf(out, "\n");
+}
+
+void hist_print_json(FILE *out, const hist_t *h)
+{
+    fprintf(out, "{\"count\":%lu,\"min\":%lu,\"mean\":%.0f",
+            (unsigned long)h->total, (unsigned long)(h->total ? h->min : 0),
+            h->total ? h->sum / h->total : 0.0);
+    for (size_t i = 0; i < N_REPORT; ++i)
+        fprintf(out, ",\"%s\":%lu", report_names[i], (unsigned long)hist_percentile(h, report_pcts[i]));
+    fprintf(out, ",\"max\":%lu}", (unsigned long)h->max);
+}
@@ -0,0 +1,45 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * HDR-style log-linear latency histogram (nanoseconds).
+ * Every power-of-two range is split into HIST_SUB equal buckets, so any
+ * recorded value is reported within 1/HIST_SUB (~3%) of its true value
+ * while the whole 64-bit range fits in a fixed array.
+ */
+#define HIST_SUB_BITS 5
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min, max;
+    double sum;
+} hist_t;
+
+void hist_init(hist_t *h);
+void hist_record(hist_t *h, uint64_t value);
+
+// Smallest recorded value v such that p percent of samples are <= v.
+uint64_t hist_percentile(const hist_t *h, double p);
+
+// "p50=... p90=... p99=... p99.9=... max=..." style summary.
+void hist_print(FILE *out, const char *name, const hist_t *h);
+
+// {"count":..,"mean":..,"p50":..,...,"max":..} (no trailing newline).
+void hist_print_json(FILE *out, const hist_t *h);
+
+// CLOCK_MONOTONIC_RAW: not slewed by NTP, so sub-microsecond differences between processes stay honest
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif
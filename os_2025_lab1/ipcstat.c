@@ -0,0 +1,145 @@
+/*
+ * Live view of every running sender / receiver, vmstat style:
+ *
+ *   ./ipcstat [-p pid] [delay [count]]
+ *
+ * Every `delay` seconds (default 1) it maps the stats page (STATS_KEY)
+ * read-only and prints one line per publishing process. As in vmstat, the
+ * first line of a process averages over its whole run so far; after that
+ * each line covers one interval. ipc% and blk% are the share of the
+ * interval spent inside the transport and asleep in handoff waits; depth
+ * is the queue length the process sampled, "-" if its transport cannot
+ * tell. ipcstat never writes to the page.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/shm.h>
+#include "hist.h"
+#include "mailbox.h"
+#include "stats.h"
+
+#define HEADER_EVERY 20     // lines between two headers
+
+// What we saw in a slot last time; start_ns tells a new owner from the old one.
+typedef struct {
+    int pid;
+    uint64_t start_ns, t_ns;
+    uint64_t frames, bytes, ipc_ns, blocked_ns;
+} prev_t;
+
+static prev_t prev[STATS_SLOTS];
+
+static void header(void)
+{
+    printf("%7s %-4s %-24s %8s %10s %9s %5s %5s %6s %12s\n",
+           "pid", "role", "mode", "up(s)", "msg/s", "MB/s", "ipc%", "blk%", "depth", "frames");
+}
+
+/* 讀一個 slot；讀到一半被別人接手（pid 變了）就當作沒看到 */
+static int snapshot(const stats_slot_t *s, stats_slot_t *out)
+{
+    int pid = atomic_load_explicit(&s->pid, memory_order_acquire);
+    if (pid == 0 || !atomic_load_explicit(&s->ready, memory_order_acquire))
+        return 0;
+    out->role = s->role;
+    memcpy(out->mode, s->mode, sizeof(out->mode));
+    out->mode[sizeof(out->mode) - 1] = '\0';
+    out->start_ns = s->start_ns;
+    out->frames = atomic_load_explicit(&s->frames, memory_order_relaxed);
+    out->bytes = atomic_load_explicit(&s->bytes, memory_order_relaxed);
+    out->ipc_ns = atomic_load_explicit(&s->ipc_ns, memory_order_relaxed);
+    out->blocked_ns = atomic_load_explicit(&s->blocked_ns, memory_order_relaxed);
+    out->depth = atomic_load_explicit(&s->depth, memory_order_relaxed);
+    out->pid = pid;
+    return atomic_load_explicit(&s->pid, memory_order_acquire) == pid &&
+           atomic_load_explicit(&s->ready, memory_order_acquire);
+}
+
+// One pass over the page; returns the number of lines printed.
+static int report(const stats_page_t *page, int only_pid, int *lines)
+{
+    uint64_t now = now_ns();
+    int printed = 0;
+    for (int i = 0; i < STATS_SLOTS; ++i) {
+        stats_slot_t s;
+        prev_t *p = &prev[i];
+        if (!snapshot(&page->slots[i], &s) || (only_pid && s.pid != only_pid)) {
+            p->pid = 0;
+            continue;
+        }
+        if (p->pid != s.pid || p->start_ns != s.start_ns) {
+            // 第一次看到這個 process：從它開始到現在的平均
+            memset(p, 0, sizeof(*p));
+            p->pid = s.pid;
+            p->start_ns = p->t_ns = s.start_ns;
+        }
+
+        double dt = (now - p->t_ns) * 1e-9;
+        if (dt <= 0)
+            dt = 1e-9;
+        if (*lines % HEADER_EVERY == 0)
+            header();
+        char depth[16] = "-";
+        if (s.depth >= 0)
+            snprintf(depth, sizeof(depth), "%ld", (long)s.depth);
+        printf("%7d %-4s %-24s %8.1f %10.0f %9.2f %5.1f %5.1f %6s %12lu\n",
+               s.pid, s.role == MB_SENDER ? "send" : "recv", s.mode,
+               (now - s.start_ns) * 1e-9,
+               (s.frames - p->frames) / dt,
+               (s.bytes - p->bytes) / dt / 1e6,
+               (s.ipc_ns - p->ipc_ns) * 1e-9 / dt * 100,
+               (s.blocked_ns - p->blocked_ns) * 1e-9 / dt * 100,
+               depth, (unsigned long)s.frames);
+        (*lines)++;
+        printed++;
+
+        p->t_ns = now;
+        p->frames = s.frames;
+        p->bytes = s.bytes;
+        p->ipc_ns = s.ipc_ns;
+        p->blocked_ns = s.blocked_ns;
+    }
+    return printed;
+}
+
+int main(int argc, char *argv[])
+{
+    int only_pid = 0, opt;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        switch (opt) {
+        case 'p': only_pid = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: ./ipcstat [-p pid] [delay [count]]\n");
+            return 1;
+        }
+    }
+    double delay = optind < argc ? atof(argv[optind]) : 1.0;
+    long count = optind + 1 < argc ? atol(argv[optind + 1]) : -1;
+    if (delay <= 0) {
+        fprintf(stderr, "[ipcstat] delay must be positive\n");
+        return 1;
+    }
+
+    int lines = 0, idle = 0;
+    for (long n = 0; count < 0 || n < count; ++n) {
+        if (n > 0)
+            usleep((useconds_t)(delay * 1e6));
+        // 每次重新 attach：page 被 ipcrm 之後重建也跟得上，平常也不佔著它
+        const stats_page_t *page = stats_attach_ro();
+        int printed = page ? report(page, only_pid, &lines) : 0;
+        if (page)
+            shmdt(page);
+
+        if (printed == 0 && !idle)
+            fprintf(stderr, "[ipcstat] no sender or receiver is running\n");
+        // 都結束了就重印 header，下一批 process 的欄位才對得上
+        if (printed == 0 && lines % HEADER_EVERY)
+            lines = 0;
+        idle = printed == 0;
+        fflush(stdout);
+    }
+    return 0;
+}
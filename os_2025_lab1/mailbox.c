@@ -0,0 +1,630 @@
+#include "mailbox.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/shm.h>
+
+_Static_assert(sizeof(message_t) <= RING_SLOT_DATA, "message_t must fit in a ring slot");
+
+/* 依 mode 編號排好，mailbox_lookup() 直接拿 flag - 1 當 index */
+static const mailbox_ops_t *const registry[N_MODES] = {
+    &mailbox_msgq, &mailbox_shm, &mailbox_ring, &mailbox_mpmc,
+    &mailbox_fifo, &mailbox_socket, &mailbox_posix_mq, &mailbox_eventfd,
+    &mailbox_bcast, &mailbox_chan,
+};
+
+const mailbox_ops_t *mailbox_lookup(const char *arg, mailbox_t *mb)
+{
+    char *end;
+    long n = strtol(arg, &end, 10);
+    for (int i = 0; i < N_MODES; ++i) {
+        if ((*end == '\0' && n == i + 1) || strcmp(arg, registry[i]->name) == 0) {
+            memset(mb, 0, sizeof(*mb));
+            mb->flag = i + 1;
+            mb->ops = registry[i];
+            mb->batch_max = 1;
+            mb->producers = 1;
+            mb->readers = 1;
+            mb->channel = "lab1";
+            mb->window = 1;
+            return mb->ops;
+        }
+    }
+    return NULL;
+}
+
+void mailbox_list(FILE *out)
+{
+    for (int i = 0; i < N_MODES; ++i)
+        fprintf(out, "    %d | %-12s %s\n", i + 1, registry[i]->name, registry[i]->title);
+}
+
+void mailbox_cleanup_all(void)
+{
+    for (int i = 0; i < N_MODES; ++i)
+        if (registry[i]->cleanup)
+            registry[i]->cleanup();
+}
+
+void mailbox_label(const mailbox_t *mb, char *buf, size_t n)
+{
+    if (mb->flag == CHANNEL)
+        snprintf(buf, n, "%s:%s", mb->ops->name, mb->channel);
+    else
+        snprintf(buf, n, "%s", mb->ops->name);
+}
+
+long mailbox_depth(void *arg)
+{
+    mailbox_t *mb = arg;
+    return mb->ops->depth ? mb->ops->depth(mb) : -1;
+}
+
+/* 建立（sender）或拿到（receiver）一塊 System V shm 並 attach */
+static void *attach_shm(key_t key, size_t size)
+{
+    int shmid = shmget(key, size, 0666 | IPC_CREAT);
+    if (shmid == -1) {
+        perror("shmget");
+        return NULL;
+    }
+    // 把這塊共享記憶體「附加（attach）」到目前這個 process 的位址空間
+    void *addr = shmat(shmid, NULL, 0);
+    if (addr == (void *)-1) {
+        perror("shmat");
+        return NULL;
+    }
+    return addr;
+}
+
+static void remove_shm(key_t key, const char *what)
+{
+    int shmid = shmget(key, 0, 0666);
+    if (shmid != -1) {
+        shmctl(shmid, IPC_RMID, NULL);
+        printf("[Cleanup] Removed old %s (key=0x%x)\n", what, key);
+    }
+}
+
+/*
+ * Receiver: one message consumed. Credits go back in batches; with
+ * credit_batch <= window the sender always keeps at least one credit while
+ * nothing is in flight, so holding some back cannot deadlock.
+ */
+static void return_credit(mailbox_t *mb)
+{
+    if (mb->credit_batch < 1)
+        mb->credit_batch = mb->window > 4 ? mb->window / 4 : 1;
+    if (++mb->credits_owed >= mb->credit_batch) {
+        handoff_post_n(&mb->tx, mb->credits_owed);
+        mb->credits_owed = 0;
+    }
+}
+
+/* ---------------- 1: System V message queue ---------------- */
+
+struct msgq_state {
+    // sender: 把多個 frame 塞進同一個 System V message
+    struct { long mType; char data[]; } *batch;
+    size_t batch_cap;            // bytes available in data[] (min of msgmax, queue bytes)
+    size_t used;
+    int count;
+
+    // receiver: msgrcv() 收到的原始訊息，可能是單一 frame 或 MTYPE_BATCH
+    struct { long mType; char data[]; } *inbox;
+    size_t inbox_cap;
+    size_t off, end;             // unread frames of the current batch are data[off, end)
+};
+
+static size_t read_msgmax(void)
+{
+    size_t cap = 8192;
+    FILE *f = fopen("/proc/sys/kernel/msgmax", "r");
+    if (f) {
+        if (fscanf(f, "%zu", &cap) != 1)
+            cap = 8192;
+        fclose(f);
+    }
+    return cap;
+}
+
+static int msgq_open(mailbox_t *mb, int role)
+{
+    // 建立或取得一個message queue
+    int qid = msgget(MQ_KEY, 0666 | IPC_CREAT);
+    if (qid == -1) {
+        perror("msgget");
+        return -1;
+    }
+    mb->storage.msqid = qid;
+
+    struct msgq_state *st = calloc(1, sizeof(*st));
+    if (!st) {
+        perror("calloc");
+        return -1;
+    }
+    mb->priv = st;
+
+    if (role == MB_SENDER && mb->batch_max > 1) {
+        // batch 不能超過 kernel 的 msgmax 跟這個 queue 的 msg_qbytes
+        st->batch_cap = read_msgmax();
+        struct msqid_ds ds;
+        if (msgctl(qid, IPC_STAT, &ds) == 0 && ds.msg_qbytes < st->batch_cap)
+            st->batch_cap = ds.msg_qbytes;
+        st->batch = malloc(sizeof(long) + st->batch_cap);
+        if (!st->batch) {
+            perror("malloc");
+            return -1;
+        }
+        printf("Batching up to %d lines / %zu bytes per message\n", mb->batch_max, st->batch_cap);
+    } else if (role == MB_RECEIVER) {
+        // 一次 msgrcv 最多收 msgmax bytes（sender 可能把好幾行打包在一起）
+        st->inbox_cap = read_msgmax();
+        if (st->inbox_cap < sizeof(message_t))
+            st->inbox_cap = sizeof(message_t);
+        st->inbox = malloc(sizeof(long) + st->inbox_cap);
+        if (!st->inbox) {
+            perror("malloc");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* 把目前累積的 batch 用一次握手 + 一次 msgsnd 送出去 */
+static void msgq_flush(mailbox_t *mb)
+{
+    struct msgq_state *st = mb->priv;
+    if (st->count == 0)
+        return;
+
+    handoff_wait(&mb->tx);
+    double t0 = mono_sec();
+
+    st->batch->mType = MTYPE_BATCH;
+    if (msgsnd(mb->storage.msqid, st->batch, st->used, 0) == -1) {
+        perror("msgsnd");
+        exit(1);
+    }
+    mb->n_syscalls++;
+
+    mb->ipc_sec += mono_sec() - t0;
+    handoff_post(&mb->rx);
+
+    st->used = 0;
+    st->count = 0;
+    mb->batch_since = 0;
+}
+
+/* frame 在 batch 裡的格式就是 message_t 去掉 mType：header + len bytes */
+static void batch_add(mailbox_t *mb, const message_t *msg)
+{
+    struct msgq_state *st = mb->priv;
+    size_t sz = MSG_BODY(msg);
+    if (st->used + sz > st->batch_cap)
+        msgq_flush(mb);
+
+    if (st->count == 0)
+        mb->batch_since = mono_sec();
+    memcpy(st->batch->data + st->used, &msg->len, sz);
+    st->used += sz;
+    st->count++;
+
+    // END / HEARTBEAT 不能卡在 batch 裡
+    if (st->count >= mb->batch_max || msg->type != REC_DATA)
+        msgq_flush(mb);
+    else if (mb->linger_us > 0 && (mono_sec() - mb->batch_since) * 1e6 >= mb->linger_us)
+        msgq_flush(mb);
+}
+
+static void msgq_send(mailbox_t *mb, const message_t *msg)
+{
+    if (mb->batch_max > 1) {
+        batch_add(mb, msg);
+        return;
+    }
+
+    handoff_wait(&mb->tx);
+    double t0 = mono_sec();
+    // 只送 header + len bytes，不是整個 msgText
+    if (msgsnd(mb->storage.msqid, msg, MSG_BODY(msg), 0) == -1) {
+        perror("msgsnd");
+        exit(1);
+    }
+    mb->n_syscalls++;
+    mb->ipc_sec += mono_sec() - t0;
+    handoff_post(&mb->rx);
+}
+
+/* 從 inbox->data[off] 拆出下一個 frame */
+static void unpack_frame(struct msgq_state *st, message_t *msg)
+{
+    const size_t hdr = MSG_HDR_SIZE - sizeof(long);
+    msg->mType = 1;
+    memcpy(&msg->len, st->inbox->data + st->off, hdr);
+    if (msg->len > sizeof(msg->msgText) || st->off + hdr + msg->len > st->end) {
+        fprintf(stderr, "[Receiver] corrupt batch at offset %zu\n", st->off);
+        exit(1);
+    }
+    memcpy(msg->msgText, st->inbox->data + st->off + hdr, msg->len);
+    st->off += hdr + msg->len;
+}
+
+static void msgq_recv(mailbox_t *mb, message_t *msg)
+{
+    struct msgq_state *st = mb->priv;
+    if (st->off < st->end) {
+        // 上一個 batch 還沒拆完：不用 syscall 也不用握手
+        double t0 = mono_sec();
+        unpack_frame(st, msg);
+        mb->ipc_sec += mono_sec() - t0;
+        return;
+    }
+
+    // 等sender（rx）
+    handoff_wait(&mb->rx);
+    double t0 = mono_sec();
+
+    // ssize_t msgrcv(int msqid, void *msgp, size_t msgsz, long msgtyp, int msgflg);
+    ssize_t n = msgrcv(mb->storage.msqid, st->inbox, st->inbox_cap, 0, 0);
+    if (n == -1) {
+        perror("msgrcv");
+        exit(1);
+    }
+    mb->n_syscalls++;
+    // 單一 frame 跟 batch 裡的 frame 格式一樣；batch 剩下的留給下一次 receive()
+    st->off = 0;
+    st->end = (size_t)n;
+    unpack_frame(st, msg);
+    if (st->inbox->mType != MTYPE_BATCH)
+        st->off = st->end = 0;
+
+    mb->ipc_sec += mono_sec() - t0;
+    // 告訴sender可以傳下一則（攢滿一批 credit 才還）
+    return_credit(mb);
+}
+
+static void msgq_close(mailbox_t *mb, int role)
+{
+    struct msgq_state *st = mb->priv;
+    if (role == MB_RECEIVER)
+        msgctl(mb->storage.msqid, IPC_RMID, NULL);
+    if (st) {
+        free(st->batch);
+        free(st->inbox);
+        free(st);
+    }
+}
+
+// batch 模式下一個 message 裝了好幾個 frame，這裡數的是 message
+static long msgq_depth(mailbox_t *mb)
+{
+    struct msqid_ds ds;
+    return msgctl(mb->storage.msqid, IPC_STAT, &ds) == -1 ? -1 : (long)ds.msg_qnum;
+}
+
+static void msgq_cleanup(void)
+{
+    // 舊的 message queue 用 msgctl 移除
+    int qid = msgget(MQ_KEY, 0666);
+    if (qid != -1) {
+        msgctl(qid, IPC_RMID, NULL);
+        printf("[Cleanup] Removed old message queue (key=0x%x)\n", MQ_KEY);
+    }
+}
+
+const mailbox_ops_t mailbox_msgq = {
+    "msg_passing", "Message Passing", 1,
+    msgq_open, msgq_send, msgq_recv, msgq_flush, msgq_close, msgq_cleanup, msgq_depth,
+};
+
+/* ---------------- 2: message_t slots in shared memory ---------------- */
+
+/*
+ * `window` slots used round-robin. Each side keeps its own slot counter
+ * (mb->slot): a credit means "the slot I will write next has been read", and
+ * every rx post means "one more slot is filled", so the counters never
+ * need to be shared.
+ */
+static int shm_open_box(mailbox_t *mb, int role)
+{
+    // 建立一塊共享記憶體，大小是 window 個 message 結構
+    mb->storage.shm_addr = attach_shm(SHM_KEY, (size_t)mb->window * sizeof(message_t));
+    return mb->storage.shm_addr ? 0 : -1;
+}
+
+static char *next_slot(mailbox_t *mb)
+{
+    char *slot = mb->storage.shm_addr + (size_t)mb->slot * sizeof(message_t);
+    mb->slot = (mb->slot + 1) % mb->window;
+    return slot;
+}
+
+static void shm_send(mailbox_t *mb, const message_t *msg)
+{
+    handoff_wait(&mb->tx);
+    double t0 = mono_sec();
+    // 長度已經在 header 裡，不需要結尾符號
+    memcpy(next_slot(mb), msg, MSG_SIZE(msg));
+    mb->ipc_sec += mono_sec() - t0;
+    handoff_post(&mb->rx);
+}
+
+static void shm_recv(mailbox_t *mb, message_t *msg)
+{
+    handoff_wait(&mb->rx);
+    double t0 = mono_sec();
+    // 先拿 header 知道長度，再只 copy len bytes 的內容
+    const char *slot = next_slot(mb);
+    memcpy(msg, slot, MSG_HDR_SIZE);
+    if (msg->len > sizeof(msg->msgText))
+        msg->len = sizeof(msg->msgText);
+    memcpy(msg->msgText, slot + MSG_HDR_SIZE, msg->len);
+    mb->ipc_sec += mono_sec() - t0;
+    return_credit(mb);
+}
+
+static void shm_close(mailbox_t *mb, int role)
+{
+    shmdt(mb->storage.shm_addr);
+    if (role == MB_RECEIVER) {
+        int shmid = shmget(SHM_KEY, 0, 0666);
+        if (shmid != -1) shmctl(shmid, IPC_RMID, NULL);
+    }
+}
+
+static void shm_cleanup(void)
+{
+    remove_shm(SHM_KEY, "shared memory");
+}
+
+const mailbox_ops_t mailbox_shm = {
+    "shared_mem", "Shared Memory", 1,
+    shm_open_box, shm_send, shm_recv, NULL, shm_close, shm_cleanup,
+};
+
+/* ---------------- 3: SPSC ring in shared memory ---------------- */
+
+int ring_box_open(mailbox_t *mb, int role)
+{
+    // 多個 slot 的 ring，sender 可以一直往前寫直到 ring 滿
+    mb->storage.ring = attach_shm(RING_KEY, sizeof(ring_t));
+    return mb->storage.ring ? 0 : -1;
+}
+
+// ring 模式不用每則都握手，只有滿了 / 空了才會在 ring_push() / ring_pop() 裡等
+void ring_box_send(mailbox_t *mb, const message_t *msg)
+{
+    double t0 = mono_sec();
+    ring_push(mb->storage.ring, msg, MSG_SIZE(msg), &mb->tx, &mb->rx);
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+void ring_box_recv(mailbox_t *mb, message_t *msg)
+{
+    double t0 = mono_sec();
+    ring_pop(mb->storage.ring, msg, sizeof(*msg), &mb->tx, &mb->rx);
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+void ring_box_close(mailbox_t *mb, int role)
+{
+    shmdt(mb->storage.ring);
+    if (role == MB_RECEIVER) {
+        int shmid = shmget(RING_KEY, 0, 0666);
+        if (shmid != -1) shmctl(shmid, IPC_RMID, NULL);
+    }
+}
+
+static long ring_depth(const ring_t *r)
+{
+    // 先讀 tail 再讀 head：兩個之間 head 只會變大，不會算出負的
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    return (long)(atomic_load_explicit(&r->head, memory_order_relaxed) - tail);
+}
+
+long ring_box_depth(mailbox_t *mb)
+{
+    return ring_depth(mb->storage.ring);
+}
+
+static void ring_cleanup(void)
+{
+    remove_shm(RING_KEY, "ring buffer");
+}
+
+const mailbox_ops_t mailbox_ring = {
+    "ring_buffer", "Ring Buffer", 1,
+    ring_box_open, ring_box_send, ring_box_recv, NULL, ring_box_close, ring_cleanup, ring_box_depth,
+};
+
+/* ---------------- 4: MPMC queue ---------------- */
+
+static int mpmc_open(mailbox_t *mb, int role)
+{
+    // MPMC 不用 control segment / semaphore：queue 自己就是會合點
+    mb->storage.mpmc = mpmc_attach(role == MB_SENDER ? mb->producers : 0);
+    if (!mb->storage.mpmc) {
+        if (role == MB_RECEIVER)
+            fprintf(stderr, "mpmc queue not found — launch ./sender -P N 4 ... or ./mpmc_bench first.\n");
+        return -1;
+    }
+    if (role == MB_RECEIVER) {
+        atomic_fetch_add(&mb->storage.mpmc->consumers, 1);
+        return 0;
+    }
+    // 沒有 receiver 就寫完離開的話，segment 會留著讓下一輪的 receiver 讀到舊資料
+    if (atomic_load(&mb->storage.mpmc->consumers) == 0)
+        printf("waiting for a receiver\n");
+    while (atomic_load(&mb->storage.mpmc->consumers) == 0)
+        usleep(1000);
+    return 0;
+}
+
+static void mpmc_send(mailbox_t *mb, const message_t *msg)
+{
+    // 好幾個 sender 共用 queue：END 不放進去，改成宣告這個 producer 結束了
+    double t0 = mono_sec();
+    if (is_eof(msg))
+        mpmc_producer_done(mb->storage.mpmc);
+    else
+        mpmc_push(mb->storage.mpmc, msg, MSG_SIZE(msg));
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void mpmc_recv(mailbox_t *mb, message_t *msg)
+{
+    double t0 = mono_sec();
+    if (mpmc_pop(mb->storage.mpmc, msg, sizeof(*msg)) == 0) {
+        // 所有 producer 都結束而且 queue 空了：當成收到 END
+        make_end(msg);
+    }
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void mpmc_close(mailbox_t *mb, int role)
+{
+    // 最後一個離開的 receiver 負責刪掉 queue
+    if (role == MB_RECEIVER && atomic_fetch_sub(&mb->storage.mpmc->consumers, 1) == 1)
+        mpmc_remove();
+    shmdt(mb->storage.mpmc);
+}
+
+static long mpmc_depth(mailbox_t *mb)
+{
+    // pos 是已經搶到的格子，還在複製中的也算進去
+    uint64_t deq = atomic_load_explicit(&mb->storage.mpmc->dequeue_pos, memory_order_relaxed);
+    uint64_t enq = atomic_load_explicit(&mb->storage.mpmc->enqueue_pos, memory_order_relaxed);
+    return enq > deq ? (long)(enq - deq) : 0;
+}
+
+// 不放 cleanup：好幾個 sender 共用這個 queue，不能把別人的清掉
+const mailbox_ops_t mailbox_mpmc = {
+    "mpmc_queue", "MPMC Queue", 0,
+    mpmc_open, mpmc_send, mpmc_recv, NULL, mpmc_close, NULL, mpmc_depth,
+};
+
+/* ---------------- 9: broadcast log ---------------- */
+
+static int bcast_open(mailbox_t *mb, int role)
+{
+    // 跟 MPMC 一樣不用 control segment：log 自己就是會合點
+    bcast_t *b = bcast_attach(role == MB_SENDER);
+    if (!b) {
+        if (role == MB_RECEIVER)
+            fprintf(stderr, "broadcast log not found — make sure you launched ./sender 9 ... first.\n");
+        return -1;
+    }
+    mb->storage.bcast = b;
+
+    if (role == MB_SENDER) {
+        // writer 不會等人，所以開始前先等 -R 個 receiver 接上
+        if (atomic_load(&b->readers) < mb->readers)
+            printf("waiting for %d receiver(s)\n", mb->readers);
+        while (atomic_load(&b->readers) < mb->readers)
+            usleep(1000);
+        return 0;
+    }
+
+    bcast_cursor_t *c = malloc(sizeof(*c));
+    if (!c) {
+        perror("malloc");
+        return -1;
+    }
+    bcast_cursor_init(c, b);
+    mb->priv = c;
+    atomic_fetch_add(&b->readers, 1);
+    return 0;
+}
+
+static void bcast_send(mailbox_t *mb, const message_t *msg)
+{
+    double t0 = mono_sec();
+    if (is_eof(msg))
+        bcast_finish(mb->storage.bcast);
+    else
+        bcast_append(mb->storage.bcast, msg, MSG_SIZE(msg));
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void bcast_recv(mailbox_t *mb, message_t *msg)
+{
+    double t0 = mono_sec();
+    if (bcast_read(mb->priv, msg, sizeof(*msg)) == 0) {
+        // writer 結束而且都讀完了：當成收到 END
+        make_end(msg);
+    }
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void bcast_close(mailbox_t *mb, int role)
+{
+    bcast_t *b = mb->storage.bcast;
+    if (role == MB_RECEIVER) {
+        bcast_cursor_t *c = mb->priv;
+        printf("broadcast: lapped %lu times, %lu messages lost\n",
+               (unsigned long)c->laps, (unsigned long)c->lost);
+        free(c);
+        // 最後一個離開的 receiver 負責刪掉 log
+        if (atomic_fetch_sub(&b->readers, 1) == 1)
+            bcast_release(b);
+    } else if (atomic_load(&b->readers) == 0) {
+        bcast_release(b);
+    }
+    shmdt(b);
+}
+
+// 不放 cleanup：別的 mode 的 sender 會跑 cleanup_ipc()，不能砍掉正在用的 log
+const mailbox_ops_t mailbox_bcast = {
+    "broadcast", "Broadcast Log", 0,
+    bcast_open, bcast_send, bcast_recv, NULL, bcast_close, NULL,
+};
+
+/* ---------------- 10: named channel ---------------- */
+
+static int chan_box_open(mailbox_t *mb, int role)
+{
+    chan_dir_t *dir;
+    chan_t *ch = chan_open(mb->channel, role, &dir);
+    if (!ch)
+        return -1;
+    mb->storage.chan = ch;
+    mb->priv = dir;
+    // 每個 channel 自己帶兩個 futex word，不用 control segment
+    mb->sync = SYNC_FUTEX;
+    handoff_init(&mb->tx, NULL, &ch->space);
+    handoff_init(&mb->rx, NULL, &ch->data);
+    return 0;
+}
+
+static void chan_box_send(mailbox_t *mb, const message_t *msg)
+{
+    double t0 = mono_sec();
+    ring_push(&mb->storage.chan->ring, msg, MSG_SIZE(msg), &mb->tx, &mb->rx);
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void chan_box_recv(mailbox_t *mb, message_t *msg)
+{
+    double t0 = mono_sec();
+    ring_pop(&mb->storage.chan->ring, msg, sizeof(*msg), &mb->tx, &mb->rx);
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void chan_box_close(mailbox_t *mb, int role)
+{
+    chan_close(mb->priv, mb->storage.chan, role);
+}
+
+static long chan_box_depth(mailbox_t *mb)
+{
+    return ring_depth(&mb->storage.chan->ring);
+}
+
+// 不放 cleanup：目錄裡是所有人的 channel；死掉的 process 在下次 open 時回收
+const mailbox_ops_t mailbox_chan = {
+    "channel", "Named Channel", 1,
+    chan_box_open, chan_box_send, chan_box_recv, NULL, chan_box_close, NULL, chan_box_depth,
+};
@@ -0,0 +1,189 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "handoff.h"
+#include "ring.h"
+#include "mpmc.h"
+#include "bcast.h"
+#include "chan.h"
+#include "slab.h"
+
+#define MSG_PASSING   1   // System V message queue
+#define SHARED_MEM    2   // one message_t in System V shm
+#define RING_BUFFER   3   // SPSC ring in System V shm
+#define MPMC_QUEUE    4   // N senders / M receivers, see mpmc.h
+#define FIFO_PIPE     5   // named pipe (mkfifo)
+#define UNIX_SOCKET   6   // AF_UNIX SOCK_SEQPACKET
+#define POSIX_MQ      7   // mq_open()
+#define EVENTFD_RING  8   // SPSC ring in shm, eventfd wakeups
+#define BROADCAST     9   // 1 sender / many receivers, see bcast.h
+#define CHANNEL      10   // named SPSC channel in a shared directory, see chan.h
+#define N_MODES      10
+
+#define MQ_KEY   0x11C0DE
+#define SHM_KEY  0x22C0DE
+#define RING_KEY 0x33C0DE
+#define CTL_KEY  0x44C0DE
+#define SEM_TX   "/tx_sem"
+#define SEM_RX   "/rx_sem"
+
+// message_t.type
+#define REC_DATA       0   // a line, or part of one (MSG_CONT)
+#define REC_END        1   // end of stream, no payload
+#define REC_HEARTBEAT  2   // sender is alive but has nothing to send (sender -H)
+
+// message_t.flags
+#define MSG_CONT 0x1   // record continues in the next message (long line split into chunks)
+#define MSG_MAP  0x2   // zero-copy: msgText is the path the receiver should mmap
+#define MSG_REF  0x4   // zero-copy: msgText is a msg_ref_t into that mapping
+#define MSG_SLAB 0x8   // msgText is a msg_ref_t whose off is a slab handle (see slab.h)
+#define MSG_CRC  0x10  // crc holds the CRC32C of msgText[0, len), or with MSG_REF / MSG_SLAB
+                       // of the payload the msg_ref_t points to (sender -K)
+
+typedef struct {
+    /*  Length-prefixed frame: only the header plus `len` bytes of msgText
+        are copied into the queue / shared memory, msgText is NOT
+        NUL-terminated.
+    */
+    long mType;
+    uint32_t len;          // payload bytes used in msgText
+    uint16_t type;         // REC_DATA / REC_END / REC_HEARTBEAT
+    uint16_t flags;        // MSG_CONT ...
+    uint32_t seq;          // per-sender frame number starting at 1 (0: made up by the transport)
+    uint32_t crc;          // valid with MSG_CRC
+    uint64_t send_ns;      // CLOCK_MONOTONIC_RAW when send() was called (sender -T), else 0
+    char msgText[1024];
+} message_t;
+
+#define MSG_HDR_SIZE   offsetof(message_t, msgText)
+#define MSG_SIZE(m)    (MSG_HDR_SIZE + (m)->len)          // bytes to copy for this frame
+#define MSG_BODY(m)    (MSG_SIZE(m) - sizeof(long))       // msgsnd() size (excludes mType)
+#define MSG_FRAME(m)   ((char *)(m) + sizeof(long))        // start of those MSG_BODY bytes
+
+// Payload of a MSG_REF frame: the record is map[off, off + len).
+// MSG_SLAB frames reuse it with off = slab handle.
+typedef struct {
+    uint64_t off;
+    uint64_t len;
+} msg_ref_t;
+
+// mType of a MSG_PASSING message that packs several frames back to back,
+// each laid out as message_t without mType (header, then len payload bytes)
+#define MTYPE_BATCH 2
+
+#define MB_SENDER   0
+#define MB_RECEIVER 1
+
+typedef struct mailbox mailbox_t;
+
+/*
+ * One transport. open() is called after the control segment is ready
+ * (tx / rx already point at the sem or futex handoff) and returns 0 or -1;
+ * send() / recv() move exactly one frame and exit(1) on a fatal error.
+ * flush() may be NULL. cleanup() removes objects a crashed run left behind.
+ * depth() is called from the stats sampler thread, once a second, and returns
+ * how many frames are queued right now; NULL if the transport cannot tell.
+ */
+typedef struct {
+    const char *name;       // mode name on the command line and in -J reports
+    const char *title;      // banner printed at startup
+    int uses_handoff;       // synchronizes through mailbox_t.tx / rx
+    int  (*open)(mailbox_t *mb, int role);
+    void (*send)(mailbox_t *mb, const message_t *msg);
+    void (*recv)(mailbox_t *mb, message_t *msg);
+    void (*flush)(mailbox_t *mb);
+    void (*close)(mailbox_t *mb, int role);
+    void (*cleanup)(void);
+    long (*depth)(mailbox_t *mb);
+} mailbox_ops_t;
+
+struct mailbox {
+    int flag;                   // MSG_PASSING ... CHANNEL
+    const mailbox_ops_t *ops;
+    union{
+        int msqid;              // MSG_PASSING
+        char* shm_addr;         // SHARED_MEM
+        ring_t* ring;           // RING_BUFFER / EVENTFD_RING: SPSC ring in shared memory
+        mpmc_t* mpmc;           // MPMC_QUEUE: bounded MPMC queue shared by N senders / M receivers
+        bcast_t* bcast;         // BROADCAST: log every receiver reads in full
+        chan_t* chan;           // CHANNEL: our channel inside the directory (priv is the directory)
+        int fd;                 // FIFO_PIPE / UNIX_SOCKET / POSIX_MQ
+    }storage;
+    void *priv;                 // backend-private state (batch buffer, read buffer, ...)
+
+    int sync;                   // SYNC_SEM / SYNC_FUTEX / SYNC_EVENTFD
+    handoff_t tx, rx;           // sender waits on tx, receiver waits on rx
+
+    // Credit window (modes 1 and 2): tx starts at `window` instead of 1, so the
+    // sender can run up to `window` messages ahead. The receiver hands the
+    // credits back `credit_batch` at a time instead of one post per message.
+    int window;
+    int credit_batch;
+    int credits_owed;           // consumed but not yet returned
+    int slot;                   // SHARED_MEM: next slot this side writes / reads
+
+    int batch_max;              // sender -b (MSG_PASSING)
+    long linger_us;             // sender -l (MSG_PASSING)
+    double batch_since;         // mono_sec() of the oldest frame in the pending batch, 0 if none
+    int producers;              // sender -P (MPMC_QUEUE)
+    int readers;                // sender -R (BROADCAST): receivers to wait for before the first line
+    const char *channel;        // -C (CHANNEL)
+
+    double ipc_sec;             // time spent inside the transport, not counting handoff waits
+    size_t n_syscalls;          // msgsnd / msgrcv calls (MSG_PASSING)
+};
+
+extern const mailbox_ops_t mailbox_msgq, mailbox_shm, mailbox_ring, mailbox_mpmc;
+extern const mailbox_ops_t mailbox_fifo, mailbox_socket, mailbox_posix_mq, mailbox_eventfd;
+extern const mailbox_ops_t mailbox_bcast, mailbox_chan;
+
+/* "3" or "ring_buffer" -> ops, filling mb->flag; NULL if unknown */
+const mailbox_ops_t *mailbox_lookup(const char *arg, mailbox_t *mb);
+void mailbox_list(FILE *out);
+void mailbox_cleanup_all(void);
+// stats_open() callback: mb->ops->depth(mb), or -1
+long mailbox_depth(void *mb);
+// "ring_buffer", or "channel:NAME" in mode 10
+void mailbox_label(const mailbox_t *mb, char *buf, size_t n);
+
+// Mode 3 entry points, shared with the eventfd ring (mode 8).
+int  ring_box_open(mailbox_t *mb, int role);
+void ring_box_send(mailbox_t *mb, const message_t *msg);
+void ring_box_recv(mailbox_t *mb, message_t *msg);
+void ring_box_close(mailbox_t *mb, int role);
+long ring_box_depth(mailbox_t *mb);
+
+/*
+ * Modes 4, 9 and 10 find each other through their own segment. They skip
+ * the control segment and the named semaphores, which every other mode
+ * shares under fixed names, and must not run cleanup_ipc().
+ */
+static inline int mailbox_uses_ctl(const mailbox_t *mb)
+{
+    return mb->flag != MPMC_QUEUE && mb->flag != BROADCAST && mb->flag != CHANNEL;
+}
+
+static inline double mono_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline int is_eof(const message_t *m) {
+    return m->type == REC_END;
+}
+
+// What mpmc / broadcast hand the receiver once every sender is finished.
+static inline void make_end(message_t *m)
+{
+    memset(m, 0, MSG_HDR_SIZE);
+    m->type = REC_END;
+}
+
+#endif
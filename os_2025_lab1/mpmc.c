@@ -0,0 +1,222 @@
+#include "mpmc.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define MPMC_SPIN 200
+
+static int spin_budget = -1;    // 0 on a uniprocessor, see handoff_init()
+
+/*
+ * A segment that has been attached before but has nobody attached now is
+ * left over from an earlier run that was killed (see mpmc.h):
+ * remove it. One that was never attached is still being created.
+ */
+static int drop_stale(int id)
+{
+    struct shmid_ds ds;
+    if (shmctl(id, IPC_STAT, &ds) == -1 || ds.shm_nattch != 0 || ds.shm_atime == 0)
+        return 0;
+    shmctl(id, IPC_RMID, NULL);
+    return 1;
+}
+
+mpmc_t *mpmc_attach(int producers)
+{
+    int id = -1, created = 0;
+
+    if (spin_budget < 0)
+        spin_budget = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? MPMC_SPIN : 0;
+
+    if (producers > 0) {
+        // 多個 sender 同時起來時只有一個會建立成功，其他的 attach 後等 ready
+        do {
+            id = shmget(MPMC_KEY, sizeof(mpmc_t), 0666 | IPC_CREAT | IPC_EXCL);
+            if (id != -1)
+                created = 1;
+            else if (errno == EEXIST)
+                id = shmget(MPMC_KEY, sizeof(mpmc_t), 0666);
+        } while (!created && (id != -1 ? drop_stale(id) : errno == ENOENT));
+    } else {
+        for (int i = 0; i <= 50 && id == -1; ++i) {
+            id = shmget(MPMC_KEY, 0, 0666);
+            if (id == -1 && errno != ENOENT)
+                break;
+            // 舊的不算，等 sender 建新的
+            if (id != -1 && drop_stale(id))
+                id = -1;
+            if (id == -1)
+                usleep(20 * 1000);
+        }
+    }
+    if (id == -1) {
+        perror("shmget(mpmc)");
+        return NULL;
+    }
+
+    mpmc_t *q = (mpmc_t *)shmat(id, NULL, 0);
+    if (q == (mpmc_t *)-1) {
+        perror("shmat(mpmc)");
+        return NULL;
+    }
+
+    if (created) {
+        for (uint64_t i = 0; i < MPMC_SLOTS; ++i)
+            atomic_store_explicit(&q->cells[i].seq, i, memory_order_relaxed);
+        q->producers = producers;
+        atomic_store_explicit(&q->ready, 1, memory_order_release);
+    } else {
+        for (int i = 0; i <= 50 && !atomic_load_explicit(&q->ready, memory_order_acquire); ++i)
+            usleep(20 * 1000);
+        if (!atomic_load_explicit(&q->ready, memory_order_acquire)) {
+            fprintf(stderr, "mpmc queue was never initialised\n");
+            shmdt(q);
+            return NULL;
+        }
+        // producers_done 是照建立時的人數算的，人數不一樣就永遠等不到（或太早）結束
+        if (producers > 0 && q->producers != producers) {
+            fprintf(stderr, "mpmc queue was created for %d sender(s), not -P %d\n",
+                    q->producers, producers);
+            shmdt(q);
+            return NULL;
+        }
+    }
+    return q;
+}
+
+void mpmc_remove(void)
+{
+    int id = shmget(MPMC_KEY, 0, 0666);
+    if (id != -1)
+        shmctl(id, IPC_RMID, NULL);
+}
+
+static int try_push(mpmc_t *q, const void *buf, size_t len)
+{
+    uint64_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        uint64_t seq = atomic_load_explicit(&q->cells[pos & (MPMC_SLOTS - 1)].seq, memory_order_acquire);
+        int64_t dif = (int64_t)(seq - pos);
+        if (dif == 0) {
+            // cell 是空的：搶 pos，搶到了這格就是我的
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return 0;   // 滿了
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    if (len > MPMC_CELL_DATA)
+        len = MPMC_CELL_DATA;
+    memcpy(q->cells[pos & (MPMC_SLOTS - 1)].data, buf, len);
+    q->cells[pos & (MPMC_SLOTS - 1)].len = (uint32_t)len;
+    atomic_store_explicit(&q->cells[pos & (MPMC_SLOTS - 1)].seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+static size_t try_pop(mpmc_t *q, void *buf, size_t cap)
+{
+    uint64_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        uint64_t seq = atomic_load_explicit(&q->cells[pos & (MPMC_SLOTS - 1)].seq, memory_order_acquire);
+        int64_t dif = (int64_t)(seq - (pos + 1));
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return 0;   // 空的
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+    size_t len = q->cells[pos & (MPMC_SLOTS - 1)].len;
+    if (len > cap)
+        len = cap;
+    memcpy(buf, q->cells[pos & (MPMC_SLOTS - 1)].data, len);
+    // 下一輪（pos + MPMC_SLOTS）的 producer 才能用這格
+    atomic_store_explicit(&q->cells[pos & (MPMC_SLOTS - 1)].seq, pos + MPMC_SLOTS, memory_order_release);
+    return len;
+}
+
+// 有人睡在 evt 上才 bump + FUTEX_WAKE
+static void signal_event(_Atomic int *evt, _Atomic int *waiters)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(evt, 1);
+        futex_wake(evt, 1);
+    }
+}
+
+void mpmc_push(mpmc_t *q, const void *buf, size_t len)
+{
+    for (;;) {
+        for (int i = 0; i < spin_budget; ++i) {
+            if (try_push(q, buf, len))
+                goto pushed;
+            cpu_relax();
+        }
+
+        // 先記下 event 值並登記，再試一次；之後有人 pop 的話 futex_wait 會直接返回
+        int e = atomic_load(&q->space_evt);
+        atomic_fetch_add(&q->space_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (try_push(q, buf, len)) {
+            atomic_fetch_sub(&q->space_waiters, 1);
+            goto pushed;
+        }
+        futex_wait(&q->space_evt, e);
+        atomic_fetch_sub(&q->space_waiters, 1);
+    }
+pushed:
+    signal_event(&q->data_evt, &q->data_waiters);
+}
+
+size_t mpmc_pop(mpmc_t *q, void *buf, size_t cap)
+{
+    size_t len;
+    for (;;) {
+        for (int i = 0; i < spin_budget; ++i) {
+            if ((len = try_pop(q, buf, cap)) > 0)
+                goto popped;
+            cpu_relax();
+        }
+
+        int e = atomic_load(&q->data_evt);
+        atomic_fetch_add(&q->data_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ((len = try_pop(q, buf, cap)) > 0) {
+            atomic_fetch_sub(&q->data_waiters, 1);
+            goto popped;
+        }
+        if (atomic_load(&q->producers_done) >= q->producers) {
+            // producer 都結束了：它們最後的 push 一定看得到，再試最後一次
+            atomic_fetch_sub(&q->data_waiters, 1);
+            if ((len = try_pop(q, buf, cap)) > 0)
+                goto popped;
+            return 0;
+        }
+        futex_wait(&q->data_evt, e);
+        atomic_fetch_sub(&q->data_waiters, 1);
+    }
+popped:
+    signal_event(&q->space_evt, &q->space_waiters);
+    return len;
+}
+
+void mpmc_producer_done(mpmc_t *q)
+{
+    atomic_fetch_add(&q->producers_done, 1);
+    // 叫醒所有睡著的 consumer，讓它們自己檢查是不是該結束了
+    atomic_fetch_add(&q->data_evt, 1);
+    futex_wake(&q->data_evt, INT_MAX);
+}
@@ -0,0 +1,67 @@
+#ifndef MPMC_H
+#define MPMC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "ring.h"
+
+#define MPMC_KEY        0x55C0DE
+#define MPMC_SLOTS      1024    // must be a power of two
+#define MPMC_CELL_DATA  RING_SLOT_DATA
+
+/*
+ * Bounded multi-producer / multi-consumer queue (Vyukov) in a System V shm
+ * segment. Each cell carries a sequence number: seq == pos means free for
+ * the producer that claims pos, seq == pos + 1 means full for the consumer
+ * that claims pos. Producers and consumers claim positions with a CAS on
+ * enqueue_pos / dequeue_pos and never touch each other's counters.
+ *
+ * Termination: `producers` is fixed when the segment is created, every
+ * sender bumps `producers_done` when it is finished, and consumers stop
+ * once the queue is empty and producers_done == producers. Senders only
+ * start once a receiver is attached, so a segment with no attachments
+ * left is a leftover (of a run that was killed) and is never reused.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t enqueue_pos;
+    _Alignas(CACHE_LINE) _Atomic uint64_t dequeue_pos;
+
+    _Alignas(CACHE_LINE) _Atomic int ready;
+    int producers;
+    _Atomic int producers_done;
+    _Atomic int consumers;          // attached receivers; the last one out removes the segment
+
+    // futex event counters: bumped on push/pop when somebody sleeps on them
+    _Alignas(CACHE_LINE) _Atomic int data_evt;
+    _Atomic int data_waiters;
+    _Alignas(CACHE_LINE) _Atomic int space_evt;
+    _Atomic int space_waiters;
+
+    _Alignas(CACHE_LINE) struct {
+        _Atomic uint64_t seq;
+        uint32_t len;
+        char data[MPMC_CELL_DATA];
+    } cells[MPMC_SLOTS];
+} mpmc_t;
+
+/*
+ * Attach to the queue. With producers > 0 the segment is created (and
+ * initialised) if it does not exist yet, and must have been created for
+ * that many producers if it does; otherwise wait up to ~1s for a sender
+ * or driver to create it. A segment nobody is attached to any more is
+ * left over from an earlier run and is replaced. Returns NULL on failure.
+ */
+mpmc_t *mpmc_attach(int producers);
+void mpmc_remove(void);
+
+// Blocks while the queue is full.
+void mpmc_push(mpmc_t *q, const void *buf, size_t len);
+
+// Blocks while the queue is empty; returns 0 once every producer is done and the queue is drained.
+size_t mpmc_pop(mpmc_t *q, void *buf, size_t cap);
+
+// Called once by each producer after its last push.
+void mpmc_producer_done(mpmc_t *q);
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Launch N senders and M receivers on the mode 4 MPMC queue and report the
+ * aggregate throughput for every (N, M) combination:
+ *
+ *   ./mpmc_bench [-p 1,2,4] [-c 1,2,4] [input.txt]
+ *
+ * Every sender pushes the whole input, so one run moves N * frames messages.
+ * Children's stdout goes to /dev/null so the terminal is not the bottleneck.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/shm.h>
+#include "mpmc.h"
+#include "bench.h"
+
+#define MAX_PROCS 64
+
+static double run_once(int n_prod, int n_cons, const char *input)
+{
+    char prod_arg[16];
+    snprintf(prod_arg, sizeof(prod_arg), "%d", n_prod);
+
+    // 先把 queue 建好，sender / receiver 都只是 attach
+    mpmc_remove();
+    mpmc_t *q = mpmc_attach(n_prod);
+    if (!q)
+        exit(1);
+
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+
+    int failed = 0;
+    for (int i = 0; i < n_cons; ++i) {
+        char *argv[] = { "./receiver", "4", NULL };
+        bench_launch(argv);
+    }
+    for (int i = 0; i < n_prod; ++i) {
+        char *argv[] = { "./sender", "-P", prod_arg, "4", (char *)input, NULL };
+        bench_launch(argv);
+    }
+    int status;
+    while (wait(&status) > 0)
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    shmdt(q);
+    mpmc_remove();
+
+    if (failed)
+        fprintf(stderr, "[mpmc_bench] a child failed for N=%d M=%d\n", n_prod, n_cons);
+    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    int prods[MAX_PROCS] = { 1, 2, 4 }, n_prods = 3;
+    int conss[MAX_PROCS] = { 1, 2, 4 }, n_conss = 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:c:")) != -1) {
+        switch (opt) {
+        case 'p': n_prods = bench_parse_list(optarg, prods, MAX_PROCS); break;
+        case 'c': n_conss = bench_parse_list(optarg, conss, MAX_PROCS); break;
+        default:
+            fprintf(stderr, "Usage: ./mpmc_bench [-p 1,2,4] [-c 1,2,4] [input.txt]\n");
+            return 1;
+        }
+    }
+    const char *input = optind < argc ? argv[optind] : "input.txt";
+    size_t frames = bench_count_frames(input);
+
+    printf("%9s %9s %12s %10s %12s\n", "senders", "receivers", "messages", "seconds", "msg/s");
+    for (int i = 0; i < n_prods; ++i) {
+        for (int j = 0; j < n_conss; ++j) {
+            double sec = run_once(prods[i], conss[j], input);
+            size_t total = frames * prods[i];
+            printf("%9d %9d %12zu %10.4f %12.0f\n", prods[i], conss[j], total, sec, total / sec);
+        }
+    }
+    return 0;
+}
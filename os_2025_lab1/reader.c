@@ -0,0 +1,243 @@
+#define _GNU_SOURCE   // memrchr
+#include "reader.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *xrealloc(void *p, size_t n)
+{
+    p = realloc(p, n);
+    if (!p) {
+        perror("realloc");
+        exit(1);
+    }
+    return p;
+}
+
+static size_t read_some(reader_t *r, char *buf, size_t n)
+{
+    double t0 = now_sec();
+    ssize_t got;
+    while ((got = read(r->fd, buf, n)) < 0) {
+        if (errno != EINTR) {
+            perror("read");
+            exit(1);
+        }
+    }
+    r->read_sec += now_sec() - t0;
+    return (size_t)got;
+}
+
+static void add_line(chunk_t *c, size_t end)
+{
+    if (c->n_lines == c->ends_cap) {
+        c->ends_cap = c->ends_cap ? c->ends_cap * 2 : 4096;
+        c->ends = xrealloc(c->ends, c->ends_cap * sizeof(size_t));
+    }
+    c->ends[c->n_lines++] = end;
+}
+
+/*
+ * Fill c with whole lines, starting with the `carry` bytes left over from
+ * the previous chunk. Returns 0 once the file is exhausted (c then holds
+ * the last lines, possibly none).
+ */
+static int fill_chunk(reader_t *r, chunk_t *c, char **carry, size_t *carry_len)
+{
+    c->len = c->n_lines = 0;
+    if (*carry_len > c->cap) {
+        c->cap = *carry_len * 2;
+        c->buf = xrealloc(c->buf, c->cap);
+    }
+    memcpy(c->buf, *carry, *carry_len);
+    size_t used = *carry_len;
+    *carry_len = 0;
+
+    int at_eof = 0;
+    for (;;) {
+        if (used == c->cap) {
+            if (memrchr(c->buf, '\n', used))
+                break;
+            // 一行比整個 buffer 還長：放大再讀
+            c->cap *= 2;
+            c->buf = xrealloc(c->buf, c->cap);
+        }
+        size_t want = c->cap - used;
+        size_t got = read_some(r, c->buf + used, want);
+        if (got == 0) {
+            at_eof = 1;
+            break;
+        }
+        used += got;
+        // 短讀（pipe 暫時沒資料）而且已經有完整的行，就先交出去
+        if (got < want && memrchr(c->buf + used - got, '\n', got))
+            break;
+    }
+
+    // 切行：最後一個換行之後的留給下一個 chunk
+    size_t start = 0;
+    const char *nl;
+    while ((nl = memchr(c->buf + start, '\n', used - start))) {
+        start = (size_t)(nl - c->buf) + 1;
+        add_line(c, start);
+    }
+    if (at_eof && start < used) {
+        // 檔案最後一行沒有換行
+        add_line(c, used);
+        start = used;
+    }
+    c->len = start;
+
+    if (start < used) {
+        *carry = xrealloc(*carry, used - start);
+        memcpy(*carry, c->buf + start, used - start);
+        *carry_len = used - start;
+    }
+    return !at_eof;
+}
+
+static void *reader_main(void *arg)
+{
+    reader_t *r = arg;
+    char *carry = NULL;
+    size_t carry_len = 0;
+
+    for (size_t i = 0;; ++i) {
+        pthread_mutex_lock(&r->lock);
+        if (i - r->released == READER_BUFS) {
+            double t0 = now_sec();
+            while (i - r->released == READER_BUFS)
+                pthread_cond_wait(&r->released_cv, &r->lock);
+            r->wait_free_sec += now_sec() - t0;
+        }
+        pthread_mutex_unlock(&r->lock);
+
+        // 只有這個 thread 會碰 chunks[i % READER_BUFS]，直到 filled 超過 i
+        chunk_t *c = &r->chunks[i % READER_BUFS];
+        int last = !fill_chunk(r, c, &carry, &carry_len);
+
+        pthread_mutex_lock(&r->lock);
+        if (c->n_lines > 0)
+            r->filled = i + 1;
+        if (last)
+            r->eof = 1;
+        pthread_cond_signal(&r->filled_cv);
+        pthread_mutex_unlock(&r->lock);
+        if (last)
+            break;
+    }
+    free(carry);
+    return NULL;
+}
+
+int reader_start(reader_t *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0) {
+        perror("open");
+        return -1;
+    }
+    // 一般檔案才有用；pipe 之類會回 ESPIPE，忽略
+    posix_fadvise(r->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (int i = 0; i < READER_BUFS; ++i) {
+        r->chunks[i].cap = READER_CHUNK;
+        r->chunks[i].buf = malloc(READER_CHUNK);
+        if (!r->chunks[i].buf) {
+            perror("malloc");
+            return -1;
+        }
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->filled_cv, NULL);
+    pthread_cond_init(&r->released_cv, NULL);
+
+    int err = pthread_create(&r->thread, NULL, reader_main, r);
+    if (err) {
+        errno = err;
+        perror("pthread_create");
+        return -1;
+    }
+    return 0;
+}
+
+chunk_t *reader_next(reader_t *r)
+{
+    chunk_t *c = NULL;
+    pthread_mutex_lock(&r->lock);
+    if (r->released == r->filled && !r->eof) {
+        double t0 = now_sec();
+        while (r->released == r->filled && !r->eof)
+            pthread_cond_wait(&r->filled_cv, &r->lock);
+        r->wait_data_sec += now_sec() - t0;
+    }
+    if (r->released < r->filled)
+        c = &r->chunks[r->released % READER_BUFS];
+    pthread_mutex_unlock(&r->lock);
+    return c;
+}
+
+int reader_wait(reader_t *r, long us)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);      // pthread_cond_timedwait 預設用 REALTIME
+    until.tv_sec += us / 1000000;
+    until.tv_nsec += (us % 1000000) * 1000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    double t0 = now_sec();
+    int err = 0;
+    while (r->released == r->filled && !r->eof && err != ETIMEDOUT)
+        err = pthread_cond_timedwait(&r->filled_cv, &r->lock, &until);
+    r->wait_data_sec += now_sec() - t0;
+    int ready = r->released < r->filled || r->eof;
+    pthread_mutex_unlock(&r->lock);
+    return ready;
+}
+
+void reader_release(reader_t *r, chunk_t *c)
+{
+    (void)c;    // chunks come back in the order reader_next() handed them out
+    pthread_mutex_lock(&r->lock);
+    r->released++;
+    pthread_cond_signal(&r->released_cv);
+    pthread_mutex_unlock(&r->lock);
+}
+
+void reader_stop(reader_t *r)
+{
+    pthread_join(r->thread, NULL);
+    close(r->fd);
+    for (int i = 0; i < READER_BUFS; ++i) {
+        free(r->chunks[i].buf);
+        free(r->chunks[i].ends);
+    }
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->filled_cv);
+    pthread_cond_destroy(&r->released_cv);
+}
+
+void reader_report(const reader_t *r, double wall_sec)
+{
+    double pct = wall_sec > 0 ? 100.0 / wall_sec : 0.0;
+    printf("pipeline: wall %.6f s; reader in read() %.6f s (%.1f%%), waiting for a free buffer %.6f s (%.1f%%); "
+           "sender waiting for input %.6f s (%.1f%%)\n",
+           wall_sec, r->read_sec, r->read_sec * pct, r->wait_free_sec, r->wait_free_sec * pct,
+           r->wait_data_sec, r->wait_data_sec * pct);
+}
@@ -0,0 +1,52 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define READER_CHUNK  (1 << 20)   // bytes per read() buffer (grows for longer lines)
+#define READER_BUFS   4           // buffers circulating between the two threads
+
+/*
+ * A chunk holds whole lines only: line i is buf[ends[i - 1], ends[i])
+ * (ends[-1] == 0). The part of a read() after the last newline is carried
+ * over to the front of the next chunk.
+ */
+typedef struct {
+    char *buf;
+    size_t cap, len;
+    size_t *ends;
+    size_t n_lines, ends_cap;
+} chunk_t;
+
+/*
+ * Sender input pipeline: a reader thread read()s the file into READER_BUFS
+ * chunk buffers and splits the lines, while the main thread sends the
+ * lines of the previous chunk. The *_sec fields say how long each side
+ * was stuck, to tell whether the disk or the IPC is the bottleneck.
+ */
+typedef struct {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t filled_cv, released_cv;
+    chunk_t chunks[READER_BUFS];
+    size_t filled, released;    // chunks handed to / returned by the main thread
+    int eof;
+
+    double read_sec;            // reader thread inside read()
+    double wait_free_sec;       // reader thread waiting for a free buffer (IPC is slower)
+    double wait_data_sec;       // main thread waiting for a filled chunk (disk is slower)
+} reader_t;
+
+int reader_start(reader_t *r, const char *path);
+// Next chunk in file order, or NULL after the last one.
+chunk_t *reader_next(reader_t *r);
+// Wait up to us microseconds for reader_next() to have something; 0 on timeout.
+int reader_wait(reader_t *r, long us);
+// Give the chunk returned by reader_next() back to the reader thread.
+void reader_release(reader_t *r, chunk_t *c);
+void reader_stop(reader_t *r);
+void reader_report(const reader_t *r, double wall_sec);
+
+#endif
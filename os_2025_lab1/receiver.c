@@ -6,20 +6,102 @@
 #include <sys/msg.h>
 #include <sys/shm.h>
 #include <string.h>
-
-#define MQ_KEY   0x11C0DE
-#define SHM_KEY  0x22C0DE
-#define SEM_TX   "/tx_sem"
-#define SEM_RX   "/rx_sem"
+#include <getopt.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stddef.h>
 
 static sem_t *sem_tx = NULL;
 static sem_t *sem_rx = NULL;
+static ctl_t *ctl = NULL;
+static size_t n_frames = 0;
+static stats_t live;             // 給 ipcstat 看的即時計數器
+
+// 每個 frame 帶 sender 的序號（從 1 開始），不連續就是掉了或亂序
+static uint32_t next_seq = 1;
+static unsigned long n_gaps, n_missing, n_reordered, n_crc_errors, n_heartbeats;
+
+static void check_payload(const message_t *msg, const char *data, size_t len)
+{
+    if ((msg->flags & MSG_CRC) && crc32c(data, len) != msg->crc) {
+        n_crc_errors++;
+        fprintf(stderr, "[Receiver] CRC32C mismatch in frame %u\n", msg->seq);
+    }
+}
+
+static void check_frame(const message_t *msg, const mailbox_t *mb)
+{
+    // seq 0 是 transport 自己補的 END；MPMC 的 frame 來自好幾個 sender，沒有單一順序
+    if (msg->seq != 0 && mb->flag != MPMC_QUEUE) {
+        if (msg->seq > next_seq) {
+            n_gaps++;
+            n_missing += msg->seq - next_seq;
+        } else if (msg->seq < next_seq) {
+            n_reordered++;
+        }
+        if (msg->seq >= next_seq)
+            next_seq = msg->seq + 1;
+    }
+    // reference 的 CRC 是算在它指到的內容上，解析完才能檢查（check_payload()）
+    if (!(msg->flags & (MSG_REF | MSG_SLAB)))
+        check_payload(msg, msg->msgText, msg->len);
+}
 
-static double total_sec = 0.0;
-static struct timespec t0, t1;
+// -T: end-to-end latency (send() 被呼叫 → receive() 拿到) 跟 throughput
+static int instrument = 0;
+static const char *json_path = NULL;     // -J: also write the report as JSON
+static hist_t latency;
+static uint64_t first_ns, last_ns, n_bytes;
 
-static inline double elapsed_sec(struct timespec a, struct timespec b) {
-    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+// 每行輸出交給 writer thread；-q 時完全不排版，只累計行數 / bytes / hash
+static int quiet = 0;
+static writer_t out;
+static uint64_t out_bytes, out_hash = 0xcbf29ce484222325ULL;   // FNV-1a offset basis
+
+#define RECV_PREFIX "Receiving message: "
+
+static void emit_line(const char *text, size_t len)
+{
+    if (quiet) {
+        for (size_t i = 0; i < len; ++i)
+            out_hash = (out_hash ^ (unsigned char)text[i]) * 0x100000001b3ULL;
+        out_hash = (out_hash ^ '\n') * 0x100000001b3ULL;
+        out_bytes += len + 1;
+        return;
+    }
+    writer_put(&out, RECV_PREFIX, sizeof(RECV_PREFIX) - 1);
+    writer_put(&out, text, len);
+    writer_put(&out, "\n", 1);
+    writer_commit(&out);
+    out_bytes += sizeof(RECV_PREFIX) + len;
+}
+
+// Receiver 先 attach sender 建好的 control segment，才知道要用哪種 handoff
+static ctl_t* attach_ctl_with_retry(int max_retry, int retry_ms) {
+    for (int i = 0; i <= max_retry; ++i) {
+        int id = shmget(CTL_KEY, 0, 0666);
+        if (id != -1) {
+            ctl_t *c = (ctl_t *)shmat(id, NULL, 0);
+            if (c == (ctl_t *)-1) {
+                perror("shmat(ctl)");
+                return NULL;
+            }
+            // sender 最後才把 ready 設起來
+            while (!atomic_load_explicit(&c->ready, memory_order_acquire) && i++ <= max_retry)
+                usleep(retry_ms * 1000);
+            if (atomic_load_explicit(&c->ready, memory_order_acquire))
+                return c;
+            shmdt(c);
+            return NULL;
+        }
+        if (errno != ENOENT) {
+            perror("shmget(ctl)");
+            break;
+        }
+        usleep(retry_ms * 1000);
+    }
+    return NULL;
 }
 
 // Receiver要先打開sender開的semaphore
@@ -41,128 +123,307 @@ static sem_t* open_semaphore_with_retry(const char *name, int max_retry, int ret
 
 static void receive(message_t *msg, mailbox_t *mb)
 {
-    // 等sender（sem_rx）
-    // S--
-    if (sem_wait(sem_rx) == -1) {
-        // System call error
-        perror("sem_wait(sem_rx)");
-        exit(1);
-    }
+    n_frames++;
+    mb->ops->recv(mb, msg);
+    stats_count(live.slot, MSG_SIZE(msg), mb->ipc_sec, mb->tx.blocked_ns + mb->rx.blocked_ns);
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &t0);
+/* zero-copy：mmap sender 公布的路徑（一般檔案或 /proc/<pid>/fd/<memfd>） */
+static const char *map_published(const message_t *msg, size_t *size)
+{
+    char path[PATH_MAX];
+    size_t n = msg->len < sizeof(path) - 1 ? msg->len : sizeof(path) - 1;
+    memcpy(path, msg->msgText, n);
+    path[n] = '\0';
 
-    if (mb->flag == MSG_PASSING) {
-        // ssize_t msgrcv(int msqid, void *msgp, size_t msgsz, long msgtyp, int msgflg);
-        if (msgrcv(mb->storage.msqid, msg, sizeof(msg->msgText), 0, 0) == -1) {
-            perror("msgrcv");
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) == -1) {
+        perror(path);
+        exit(1);
+    }
+    *size = st.st_size;
+    char *base = NULL;
+    if (*size > 0) {
+        base = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            perror("mmap");
             exit(1);
         }
+        madvise(base, *size, MADV_SEQUENTIAL);
     }
-    else if (mb->flag == SHARED_MEM) {
-        // mb->storage.shm_addr->共享記憶體的起始位址
-        // 把那個區塊copy進 msg->msgText
-        strncpy(msg->msgText, mb->storage.shm_addr, sizeof(msg->msgText) - 1);
-        msg->msgText[sizeof(msg->msgText) - 1] = '\0';
-    }
-    else {
-        fprintf(stderr, "[Receiver] unknown mode: %d\n", mb->flag);
-        exit(1);
-    }
+    close(fd);
 
-    clock_gettime(CLOCK_MONOTONIC, &t1);
-    total_sec += elapsed_sec(t0, t1);
+    // sender 看到這個才能關掉 memfd 離開
+    atomic_store_explicit(&ctl->mapped, 1, memory_order_release);
+    return base;
+}
 
-    // 告訴sender可以傳下一則
-    if (sem_post(sem_tx) == -1) {
-        perror("sem_post(sem_tx)");
-        exit(1);
+static void report_stats(const mailbox_t *mb)
+{
+    double sec = (last_ns - first_ns) * 1e-9;
+    double mps = sec > 0 ? n_frames / sec : 0.0;
+    double mbps = sec > 0 ? n_bytes / sec / 1e6 : 0.0;
+
+    printf("throughput: %zu messages, %lu bytes in %.6f s = %.0f msg/s, %.2f MB/s\n",
+           n_frames, (unsigned long)n_bytes, sec, mps, mbps);
+    hist_print(stdout, "latency", &latency);
+
+    if (!json_path)
+        return;
+    FILE *out = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+    if (!out) {
+        perror("fopen(json)");
+        return;
     }
+    fprintf(out, "{\"transport\":\"%s\",\"messages\":%zu,\"bytes\":%lu,\"seconds\":%.6f,"
+                 "\"msgs_per_sec\":%.1f,\"mb_per_sec\":%.3f,\"latency_ns\":",
+            mb->ops->name, n_frames, (unsigned long)n_bytes, sec, mps, mbps);
+    hist_print_json(out, &latency);
+    fprintf(out, "}\n");
+    if (out != stdout)
+        fclose(out);
 }
 
-int main(int argc, char *argv[])
+static void usage(void)
 {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: ./receiver <mode>\n");
-        fprintf(stderr, "  mode: 1=MessagePassing, 2=SharedMemory\n");
-        return 1;
-    }
+    fprintf(stderr, "Usage: ./receiver [-q] [-T] [-J report.json] [-C channel] [-c cpu] [--busy-poll[=spins]] <mode>\n");
+    fprintf(stderr, "  mode (number or name):\n");
+    mailbox_list(stderr);
+    fprintf(stderr, "  -q       do not print the lines, only a count and an FNV-1a hash of them\n");
+    fprintf(stderr, "  -T       latency histogram (needs sender -T) and throughput report\n");
+    fprintf(stderr, "  -J FILE  also write the -T report as JSON (\"-\" for stdout)\n");
+    fprintf(stderr, "  -C NAME  mode 10: channel name (default lab1)\n");
+    fprintf(stderr, "  -c N, --cpu=N       pin the receiving thread to CPU N\n");
+    fprintf(stderr, "  --busy-poll[=SPINS] spin on the ring index / handoff word instead of sleeping;\n"
+                    "                      with SPINS, fall back to blocking after that many pauses\n");
+}
 
-    mailbox_t box;
-    box.flag = atoi(argv[1]);
+static const struct option long_opts[] = {
+    { "busy-poll", optional_argument, NULL, 'B' },
+    { "cpu",       required_argument, NULL, 'c' },
+    { NULL, 0, NULL, 0 },
+};
 
-    if (box.flag == MSG_PASSING)
-        puts("Message Passing");
-    else if (box.flag == SHARED_MEM)
-        puts("Shared Memory");
-    else {
-        fprintf(stderr, "Invalid mode. Use 1 or 2.\n");
+int main(int argc, char *argv[])
+{
+    const char *channel = NULL;
+    int cpu = -1;
+    long busy = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "qTJ:C:c:", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'q': quiet = 1; break;
+        case 'T': instrument = 1; break;
+        case 'J': instrument = 1; json_path = optarg; break;
+        case 'C': channel = optarg; break;
+        case 'B': busy = optarg ? atol(optarg) : -1; break;
+        case 'c': cpu = atoi(optarg); break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (argc - optind != 1) {
+        usage();
         return 1;
     }
 
-    sem_tx = open_semaphore_with_retry(SEM_TX, 50, 20);
-    sem_rx = open_semaphore_with_retry(SEM_RX, 50, 20);
-    if (sem_tx == SEM_FAILED || sem_rx == SEM_FAILED) {
-        fprintf(stderr, "sem_open failed — make sure you launched ./sender first.\n");
+    mailbox_t box;
+    if (!mailbox_lookup(argv[optind], &box)) {
+        fprintf(stderr, "Invalid mode: %s\n", argv[optind]);
+        usage();
         return 1;
     }
+    if (channel)
+        box.channel = channel;
+    puts(box.ops->title);
 
-    if (box.flag == MSG_PASSING) {
-        int qid = msgget(MQ_KEY, 0666 | IPC_CREAT);
-        if (qid == -1) {
-            perror("msgget");
-            return 1;
-        }
-        box.storage.msqid = qid;
-    }
-    else if (box.flag == SHARED_MEM) {
-        int shmid = shmget(SHM_KEY, sizeof(message_t), 0666 | IPC_CREAT);
-        if (shmid == -1) {
-            perror("shmget");
+    // MPMC / broadcast / channel 不用 control segment / semaphore：自己的 segment 就是會合點
+    if (mailbox_uses_ctl(&box)) {
+        ctl = attach_ctl_with_retry(50, 20);
+        if (!ctl) {
+            fprintf(stderr, "control segment not found — make sure you launched ./sender first.\n");
             return 1;
         }
-        box.storage.shm_addr = (char *)shmat(shmid, NULL, 0);
-        if (box.storage.shm_addr == (char *)-1) {
-            perror("shmat");
-            return 1;
+
+        box.sync = ctl->sync;
+        box.window = ctl->window > 0 ? ctl->window : 1;
+        if (ctl->sync == SYNC_FUTEX) {
+            handoff_init(&box.tx, NULL, &ctl->tx);
+            handoff_init(&box.rx, NULL, &ctl->rx);
+        } else {
+            sem_tx = open_semaphore_with_retry(SEM_TX, 50, 20);
+            sem_rx = open_semaphore_with_retry(SEM_RX, 50, 20);
+            if (sem_tx == SEM_FAILED || sem_rx == SEM_FAILED) {
+                fprintf(stderr, "sem_open failed — make sure you launched ./sender first.\n");
+                return 1;
+            }
+            handoff_init(&box.tx, sem_tx, NULL);
+            handoff_init(&box.rx, sem_rx, NULL);
         }
     }
 
+    if (box.ops->open(&box, MB_RECEIVER) == -1)
+        return 1;
+    box.tx.busy = box.rx.busy = busy;
+    char label[STATS_NAME];
+    mailbox_label(&box, label, sizeof(label));
+    stats_open(&live, MB_RECEIVER, label, mailbox_depth, &box);
+
     // 開始receive
     size_t n_lines = 0;
     message_t msg;
 
+    // 帶 MSG_CONT 的 frame 先接到 rec 裡，直到最後一個 frame 再組成一整行
+    char *rec = NULL;
+    size_t rec_len = 0, rec_cap = 0;
+
+    // sender -z：MSG_REF 指向這塊 mapping，不用 copy
+    const char *map = NULL;
+    size_t map_size = 0;
+
+    // sender -S：MSG_SLAB 指向 slab arena 裡的 block，印完才 release
+    slab_t *slab = NULL;
+    uint64_t held = 0;
+
+    if (instrument)
+        hist_init(&latency);
+
+    // 之後 stdout 由 writer thread 直接 writev，stdio 裡剩的要先送出去
+    fflush(stdout);
+    if (!quiet && writer_start(&out, STDOUT_FILENO) == -1)
+        return 1;
+    // writer thread 起來之後才綁，它不會跟 busy poll 的 receive loop 擠同一顆 CPU
+    if (cpu >= 0 && pin_to_cpu(cpu) == -1)
+        return 1;
+
     while (1) {
         receive(&msg, &box);
 
-        // 去掉換行
-        msg.msgText[strcspn(msg.msgText, "\n")] = '\0';
+        if (instrument) {
+            last_ns = now_ns();
+            if (first_ns == 0)
+                first_ns = last_ns;
+            if (msg.send_ns != 0)
+                hist_record(&latency, last_ns - msg.send_ns);
+            if (!(msg.flags & (MSG_MAP | MSG_REF | MSG_SLAB)))
+                n_bytes += msg.len;
+        }
+
+        // 結束 / heartbeat 直接看 header 的 type，不用比對字串
+        check_frame(&msg, &box);
+        if (msg.type == REC_END)
+            break;
+        if (msg.type == REC_HEARTBEAT) {
+            n_heartbeats++;
+            continue;
+        }
 
-        // 判斷 EOF（是就跳出、不印）
-        if (strcmp(msg.msgText, "EOF") == 0) break;
+        const char *text = msg.msgText;
+        size_t len = msg.len;
+
+        if (msg.flags & MSG_MAP) {
+            map = map_published(&msg, &map_size);
+            continue;
+        }
+        if (msg.flags & MSG_REF) {
+            msg_ref_t ref;
+            memcpy(&ref, msg.msgText, sizeof(ref));
+            if (ref.off > map_size || ref.len > map_size - ref.off) {
+                fprintf(stderr, "[Receiver] reference outside mapped input\n");
+                return 1;
+            }
+            text = map + ref.off;
+            len = ref.len;
+            check_payload(&msg, text, len);
+            if (instrument)
+                n_bytes += len;
+        }
+        else if (msg.flags & MSG_SLAB) {
+            msg_ref_t ref;
+            memcpy(&ref, msg.msgText, sizeof(ref));
+            // 第一個 handle 來的時候才 attach，arena 一定已經建好了
+            if (!slab && !(slab = slab_attach(0)))
+                return 1;
+            if (!(text = slab_payload(slab, ref.off, &len))) {
+                fprintf(stderr, "[Receiver] invalid slab handle\n");
+                return 1;
+            }
+            held = ref.off;
+            check_payload(&msg, text, len);
+            if (instrument)
+                n_bytes += len;
+        }
+        else if ((msg.flags & MSG_CONT) || rec_len > 0) {
+            if (rec_len + len > rec_cap) {
+                rec_cap = (rec_len + len) * 2;
+                rec = realloc(rec, rec_cap);
+                if (!rec) {
+                    perror("realloc");
+                    return 1;
+                }
+            }
+            memcpy(rec + rec_len, text, len);
+            rec_len += len;
+            if (msg.flags & MSG_CONT)
+                continue;
+            text = rec;
+            len = rec_len;
+            rec_len = 0;
+        }
 
-        // 只有非 EOF 才印
-        printf("Receiving message: %s\n", msg.msgText);
+        // 去掉換行
+        if (len > 0 && text[len - 1] == '\n')
+            len--;
+
+        emit_line(text, len);
         n_lines++;
+        if (held) {
+            slab_release(slab, held);
+            held = 0;
+        }
     }
-
+    if (!quiet)
+        writer_stop(&out);
+    free(rec);
+    if (map)
+        munmap((void *)map, map_size);
+    if (slab)
+        slab_detach(slab);
 
     printf("Sender exit!\n");
-    printf("total IPC time(s) taken in receiving msg =%.6f\n", total_sec);
+    printf("total IPC time(s) taken in receiving msg =%.6f\n", box.ipc_sec);
+    if (quiet)
+        printf("received %zu lines, %lu bytes, fnv1a=%016lx\n",
+               n_lines, (unsigned long)out_bytes, (unsigned long)out_hash);
+    else
+        printf("output: %lu bytes in %lu writev calls\n", (unsigned long)out_bytes, out.writes);
+    printf("frames: %zu received, %lu heartbeats, %lu sequence gaps (%lu missing), %lu out of order, %lu CRC errors\n",
+           n_frames, n_heartbeats, n_gaps, n_missing, n_reordered, n_crc_errors);
+    if (box.flag == MSG_PASSING)
+        printf("messages per msgrcv = %.2f (%zu messages / %zu syscalls)\n",
+               box.n_syscalls ? (double)n_frames / box.n_syscalls : 0.0, n_frames, box.n_syscalls);
+    if (instrument)
+        report_stats(&box);
+    if (box.ops->uses_handoff)
+        handoff_report(box.sync, &box.tx, &box.rx);
 
     // --- 清理 ---
-    if (box.flag == SHARED_MEM) {
-        shmdt(box.storage.shm_addr);
-        int shmid = shmget(SHM_KEY, sizeof(message_t), 0666);
-        if (shmid != -1) shmctl(shmid, IPC_RMID, NULL);
-    }
-
-    sem_close(sem_tx);
-    sem_close(sem_rx);
-    sem_unlink(SEM_TX);
-    sem_unlink(SEM_RX);
+    stats_close(&live);
+    box.ops->close(&box, MB_RECEIVER);
 
-    if (box.flag == MSG_PASSING)
-        msgctl(box.storage.msqid, IPC_RMID, NULL);
+    if (ctl) {
+        if (ctl->sync == SYNC_SEM) {
+            sem_close(sem_tx);
+            sem_close(sem_rx);
+            sem_unlink(SEM_TX);
+            sem_unlink(SEM_RX);
+        }
+        shmdt(ctl);
+        int ctlid = shmget(CTL_KEY, 0, 0666);
+        if (ctlid != -1) shmctl(ctlid, IPC_RMID, NULL);
+    }
 
     return 0;
 }
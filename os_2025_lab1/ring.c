@@ -0,0 +1,79 @@
+#include "ring.h"
+#include <string.h>
+
+/*
+ * Wake the peer only if it announced that it is going to sleep.
+ * The seq_cst fence pairs with the store to *waiting in ring_push()/ring_pop(), so either
+ * the peer sees our index update or we see its flag (no lost wakeup).
+ */
+static void wake_peer(_Atomic int *waiting, handoff_t *h)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) &&
+        atomic_exchange(waiting, 0))
+        handoff_post(h);
+}
+
+void ring_push(ring_t *r, const void *buf, size_t len, handoff_t *space, handoff_t *data)
+{
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    if (h - r->tail_cache >= RING_SLOTS) {
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        // busy poll：先盯著 tail 轉，不宣告要睡，receiver 也就不用 post
+        for (long i = 0; h - r->tail_cache >= RING_SLOTS && (space->busy < 0 || i < space->busy); ++i) {
+            cpu_relax();
+            r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        }
+        while (h - r->tail_cache >= RING_SLOTS) {
+            // 滿了：先宣告要睡，再看一次 tail，避免錯過 receiver 的喚醒
+            atomic_store(&r->producer_waiting, 1);
+            r->tail_cache = atomic_load(&r->tail);
+            if (h - r->tail_cache < RING_SLOTS)
+                break;
+            handoff_wait(space);
+            r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        }
+        atomic_store_explicit(&r->producer_waiting, 0, memory_order_relaxed);
+    }
+
+    if (len > RING_SLOT_DATA)
+        len = RING_SLOT_DATA;
+    memcpy(r->slots[h & (RING_SLOTS - 1)].data, buf, len);
+    r->slots[h & (RING_SLOTS - 1)].len = (uint32_t)len;
+
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    wake_peer(&r->consumer_waiting, data);
+}
+
+size_t ring_pop(ring_t *r, void *buf, size_t cap, handoff_t *space, handoff_t *data)
+{
+    uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    if (t == r->head_cache) {
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        for (long i = 0; t == r->head_cache && (data->busy < 0 || i < data->busy); ++i) {
+            cpu_relax();
+            r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        }
+        while (t == r->head_cache) {
+            // 空的：同樣先宣告再確認一次 head
+            atomic_store(&r->consumer_waiting, 1);
+            r->head_cache = atomic_load(&r->head);
+            if (t != r->head_cache)
+                break;
+            handoff_wait(data);
+            r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        }
+        atomic_store_explicit(&r->consumer_waiting, 0, memory_order_relaxed);
+    }
+
+    size_t len = r->slots[t & (RING_SLOTS - 1)].len;
+    if (len > cap)
+        len = cap;
+    memcpy(buf, r->slots[t & (RING_SLOTS - 1)].data, len);
+
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+    wake_peer(&r->producer_waiting, space);
+    return len;
+}
@@ -0,0 +1,50 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "handoff.h"
+
+#define CACHE_LINE      64
+#define RING_SLOTS      256     // must be a power of two
+#define RING_SLOT_SIZE  1088    // one message_t (header + 1024-byte text) per slot
+
+/*
+ * Single-producer / single-consumer ring living in a System V shm segment.
+ * head is only written by the sender, tail only by the receiver, and each
+ * sits on its own cache line so the two processes do not false-share.
+ * A freshly created (zero-filled) segment is already a valid empty ring.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t head;   // next slot the producer fills
+    uint64_t tail_cache;                          // producer's last view of tail
+
+    _Alignas(CACHE_LINE) _Atomic uint64_t tail;   // next slot the consumer drains
+    uint64_t head_cache;                          // consumer's last view of head
+
+    // Set by a side that is about to sleep on its handoff.
+    _Alignas(CACHE_LINE) _Atomic int producer_waiting;
+    _Atomic int consumer_waiting;
+
+    _Alignas(CACHE_LINE) struct {
+        uint32_t len;
+        char data[RING_SLOT_SIZE - sizeof(uint32_t)];
+    } slots[RING_SLOTS];
+} ring_t;
+
+#define RING_SLOT_DATA (RING_SLOT_SIZE - sizeof(uint32_t))
+
+/*
+ * Copy len bytes into the next free slot. Parks on `space` only when the
+ * ring is full and posts `data` only when the consumer is parked.
+ */
+void ring_push(ring_t *r, const void *buf, size_t len, handoff_t *space, handoff_t *data);
+
+/*
+ * Copy the oldest slot into buf (at most cap bytes) and return its length.
+ * Parks on `data` only when the ring is empty.
+ */
+size_t ring_pop(ring_t *r, void *buf, size_t cap, handoff_t *space, handoff_t *data);
+
+#endif
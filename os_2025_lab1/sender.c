@@ -1,3 +1,4 @@
+#define _GNU_SOURCE   // memfd_create
 #include "sender.h"
 #include <sys/ipc.h>
 #include <sys/msg.h>
@@ -6,20 +7,30 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
-
-#define MQ_KEY   0x11C0DE
-#define SHM_KEY  0x22C0DE
-#define SEM_TX   "/tx_sem"
-#define SEM_RX   "/rx_sem"
+#include <stddef.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/mman.h>
 
 static sem_t *sem_tx = NULL;
 static sem_t *sem_rx = NULL;
-static double total_sec = 0.0;
-static struct timespec t0, t1;
+static int sync_mode = SYNC_SEM;  // -F: futex words in the control segment instead of sem_open
+static ctl_t *ctl = NULL;
+static size_t n_frames = 0;
+static int stamp = 0;            // -T: put a send timestamp in every frame
+static int checksum = 0;         // -K: CRC32C over every frame's payload
+static uint32_t next_seq = 0;
+static stats_t live;             // 給 ipcstat 看的即時計數器
 
-static inline double elapsed_sec(struct timespec a, struct timespec b) {
-    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
-}
+// -z: 輸入檔放在兩邊都 mmap 的地方，mailbox 只傳 (offset, length)
+static int zero_copy = 0;
+static const char *zc_base = NULL;
+static int zc_unmapped = 0;         // receiver never mapped the memfd: it cannot read the input
+#define ZC_MAP_WAIT_SEC 10
+
+// -S: 每行放進 shm slab arena，mailbox 只傳 handle
+static slab_t *slab = NULL;
+static const char *slab_src = NULL;  // 正在送的那行（block 送出後可能馬上被 receiver 釋放）
 
 /* 清除舊的 IPC 殘值 */
 static void cleanup_ipc() {
@@ -27,17 +38,13 @@ static void cleanup_ipc() {
     sem_unlink(SEM_TX);
     sem_unlink(SEM_RX);
 
-    // 舊的 message queue / shared memory 用 msgctl / shmctl 移除。
-    int qid = msgget(MQ_KEY, 0666);
-    if (qid != -1) {
-        msgctl(qid, IPC_RMID, NULL);
-        printf("[Cleanup] Removed old message queue (key=0x%x)\n", MQ_KEY);
-    }
+    // 舊的 message queue / shared memory / FIFO ... 交給各個 transport 自己移除。
+    mailbox_cleanup_all();
 
-    int shmid = shmget(SHM_KEY, sizeof(message_t), 0666);
+    int shmid = shmget(CTL_KEY, 0, 0666);
     if (shmid != -1) {
         shmctl(shmid, IPC_RMID, NULL);
-        printf("[Cleanup] Removed old shared memory (key=0x%x)\n", SHM_KEY);
+        printf("[Cleanup] Removed old control segment (key=0x%x)\n", CTL_KEY);
     }
 
     // 最後 unlink 保險地刪掉 /dev/shm 下殘留的 semaphore 檔案。
@@ -47,116 +54,477 @@ static void cleanup_ipc() {
     // 因為 IPC 是系統級資源，如果沒清掉會影響下次建立。
 }
 
-void send(message_t msg, mailbox_t *mb)
+static void log_sent(const message_t *msg)
+{
+    static int mid_record = 0;   // 上一個 frame 帶 MSG_CONT，這個是同一行的後續
+
+    if (msg->type != REC_DATA || (msg->flags & MSG_MAP))
+        return;
+    if (msg->flags & MSG_REF) {
+        msg_ref_t ref;
+        memcpy(&ref, msg->msgText, sizeof(ref));
+        printf("Sending message: %.*s", (int)ref.len, zc_base + ref.off);
+        return;
+    }
+    if (msg->flags & MSG_SLAB) {
+        msg_ref_t ref;
+        memcpy(&ref, msg->msgText, sizeof(ref));
+        printf("Sending message: %.*s", (int)ref.len, slab_src);
+        return;
+    }
+
+    printf("%s%.*s", mid_record ? "" : "Sending message: ", (int)msg->len, msg->msgText);
+    mid_record = (msg->flags & MSG_CONT) != 0;
+}
+
+/* 序號跟 checksum 在這裡統一填，各種 frame 的建構函式不用管 */
+void send(message_t *msg, mailbox_t *mb)
+{
+    n_frames++;
+    msg->seq = ++next_seq;
+    msg->crc = 0;
+    if (checksum) {
+        msg->flags |= MSG_CRC;
+        // 只傳 reference 的話，checksum 要算它指到的內容，不是那 16 bytes
+        msg_ref_t ref;
+        memcpy(&ref, msg->msgText, sizeof(ref));
+        if (msg->flags & MSG_REF)
+            msg->crc = crc32c(zc_base + ref.off, ref.len);
+        else if (msg->flags & MSG_SLAB)
+            msg->crc = crc32c(slab_src, ref.len);
+        else
+            msg->crc = crc32c(msg->msgText, msg->len);
+    }
+    mb->ops->send(mb, msg);
+    stats_count(live.slot, MSG_SIZE(msg), mb->ipc_sec, mb->tx.blocked_ns + mb->rx.blocked_ns);
+    log_sent(msg);
+}
+
+/* batch 之類還留在 sender 這邊的東西全部送出去 */
+static void flush(mailbox_t *mb)
 {
-    sem_wait(sem_tx);
-    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (mb->ops->flush)
+        mb->ops->flush(mb);
+}
+
+/* 把一整行切成 <= sizeof(msgText) 的 frame，除了最後一個都帶 MSG_CONT */
+static void send_record(const char *buf, size_t n, mailbox_t *mb)
+{
+    message_t msg;
+    msg.mType = 1;
+    msg.type = REC_DATA;
+    do {
+        size_t chunk = n < sizeof(msg.msgText) ? n : sizeof(msg.msgText);
+        memcpy(msg.msgText, buf, chunk);
+        msg.len = (uint32_t)chunk;
+        msg.flags = (n > chunk) ? MSG_CONT : 0;
+        // 不同 receiver 可能拿到同一行的不同段，MPMC 裡每個 frame 都要自己獨立；
+        // broadcast 落後的 receiver 會掉 frame，也不能把不相干的段接起來
+        if (mb->flag == MPMC_QUEUE || mb->flag == BROADCAST)
+            msg.flags = 0;
+        msg.send_ns = stamp ? now_ns() : 0;
+        send(&msg, mb);
+        buf += chunk;
+        n -= chunk;
+    } while (n > 0);
+}
+
+/* END / HEARTBEAT：沒有 payload，只有 header */
+static void send_control(int type, mailbox_t *mb)
+{
+    message_t msg;
+    msg.mType = 1;
+    msg.type = type;
+    msg.len = 0;
+    msg.flags = 0;
+    msg.send_ns = stamp ? now_ns() : 0;
+    send(&msg, mb);
+}
 
-    if (mb->flag == MSG_PASSING) {
-        if (msgsnd(mb->storage.msqid, &msg, sizeof(msg.msgText), 0) == -1) {
-            perror("msgsnd");
+/* 整行寫進 slab block，不管多長都只送一個帶 handle 的 frame */
+static void send_slab(const char *buf, size_t n, mailbox_t *mb)
+{
+    uint64_t handle;
+    char *p = slab_alloc(slab, n, 1, &handle);
+    if (!p) {
+        // 比最大的 block 還大，或 arena 裡再也放不下：照舊切成 frame
+        send_record(buf, n, mb);
+        return;
+    }
+    memcpy(p, buf, n);
+
+    message_t msg;
+    msg_ref_t ref = { handle, n };
+    msg.mType = 1;
+    msg.type = REC_DATA;
+    msg.len = sizeof(ref);
+    msg.flags = MSG_SLAB;
+    msg.send_ns = stamp ? now_ns() : 0;
+    memcpy(msg.msgText, &ref, sizeof(ref));
+    slab_src = buf;
+    send(&msg, mb);
+}
+
+static void send_ref(uint64_t off, uint64_t len, mailbox_t *mb)
+{
+    message_t msg;
+    msg_ref_t ref = { off, len };
+    msg.mType = 1;
+    msg.type = REC_DATA;
+    msg.len = sizeof(ref);
+    msg.flags = MSG_REF;
+    msg.send_ns = stamp ? now_ns() : 0;
+    memcpy(msg.msgText, &ref, sizeof(ref));
+    send(&msg, mb);
+}
+
+/*
+ * 把輸入變成 receiver 也能 mmap 的東西：
+ * 一般檔案直接用它的絕對路徑；pipe 之類的先讀進 memfd，
+ * receiver 再從 /proc/<pid>/fd/<n> 打開。
+ * 回傳 sender 自己的 mapping，*memfd 是 memfd（沒有用到就是 -1）。
+ */
+static const char *publish_input(const char *path, size_t *size, char *ref_path, int *memfd)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+
+    *memfd = -1;
+    if (S_ISREG(st.st_mode)) {
+        if (!realpath(path, ref_path)) {
+            perror("realpath");
+            exit(1);
+        }
+    } else {
+        *memfd = memfd_create("sender-input", 0);
+        if (*memfd < 0) {
+            perror("memfd_create");
+            exit(1);
+        }
+        char buf[1 << 16];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+            if (write(*memfd, buf, n) != n) {
+                perror("write(memfd)");
+                exit(1);
+            }
+        }
+        if (n < 0 || fstat(*memfd, &st) == -1) {
+            perror("read");
             exit(1);
         }
-    } else if (mb->flag == SHARED_MEM) {
-        strncpy(mb->storage.shm_addr, msg.msgText, sizeof(msg.msgText) - 1);
-        // 確保記憶體裡的字串有安全的結尾符號。
-        mb->storage.shm_addr[sizeof(msg.msgText) - 1] = '\0';
+        close(fd);
+        fd = *memfd;
+        snprintf(ref_path, PATH_MAX, "/proc/%d/fd/%d", (int)getpid(), *memfd);
+    }
+
+    *size = st.st_size;
+    if (*size == 0) {
+        if (fd != *memfd)
+            close(fd);
+        return NULL;
+    }
+    char *base = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    madvise(base, *size, MADV_SEQUENTIAL);
+    if (fd != *memfd)
+        close(fd);
+    return base;
+}
+
+/* 一行一個 MSG_REF，內容完全不經過 mailbox */
+static size_t send_mapped(const char *path, mailbox_t *mb)
+{
+    char ref_path[PATH_MAX];
+    size_t size, n_lines = 0;
+    int memfd;
+
+    zc_base = publish_input(path, &size, ref_path, &memfd);
+
+    message_t msg;
+    msg.mType = 1;
+    msg.type = REC_DATA;
+    msg.len = (uint32_t)strlen(ref_path);
+    msg.flags = MSG_MAP;
+    msg.send_ns = 0;
+    memcpy(msg.msgText, ref_path, msg.len);
+    send(&msg, mb);
+
+    size_t off = 0;
+    while (off < size) {
+        const char *nl = memchr(zc_base + off, '\n', size - off);
+        size_t end = nl ? (size_t)(nl - zc_base) + 1 : size;
+        send_ref(off, end - off, mb);
+        off = end;
+        n_lines++;
     }
 
-    clock_gettime(CLOCK_MONOTONIC, &t1);
-    total_sec += elapsed_sec(t0, t1);
+    send_control(REC_END, mb);
+    flush(mb);
 
-    // 只在不是 EOF 時印出訊息
-    if (strcmp(msg.msgText, "EOF") != 0 && strcmp(msg.msgText, "EOF\n") != 0) {
-        printf("Sending message: %s", msg.msgText);
+    if (memfd >= 0) {
+        // /proc/<pid>/fd 只在我們還活著時有效，等 receiver mmap 好才能走；
+        // receiver 沒起來或已經死了就不會有人設 mapped，所以只等 ZC_MAP_WAIT_SEC 秒
+        double deadline = mono_sec() + ZC_MAP_WAIT_SEC;
+        while (!atomic_load_explicit(&ctl->mapped, memory_order_acquire) && mono_sec() < deadline)
+            usleep(1000);
+        if (!atomic_load_explicit(&ctl->mapped, memory_order_acquire)) {
+            fprintf(stderr, "receiver did not map the input within %d s; it cannot read it after we exit\n",
+                    ZC_MAP_WAIT_SEC);
+            zc_unmapped = 1;
+        }
+        close(memfd);
     }
+    if (zc_base)
+        munmap((void *)zc_base, size);
+    return n_lines;
+}
 
-    sem_post(sem_rx);
+static void usage(void)
+{
+    fprintf(stderr, "Usage: ./sender [-b batch] [-l linger_us] [-w window] [-T] [-F] [-z] [-S] [-K] [-H ms] [-P producers] [-R readers] [-C channel] [-c cpu] [--busy-poll[=spins]] <mode> <input.txt>\n");
+    fprintf(stderr, "  mode (number or name):\n");
+    mailbox_list(stderr);
+    fprintf(stderr, "  -b N   pack up to N lines into one System V message (mode 1)\n");
+    fprintf(stderr, "  -l US  flush a partial batch once it is US microseconds old\n");
+    fprintf(stderr, "  -w N   modes 1, 2: up to N messages in flight before waiting for the receiver (default 1)\n");
+    fprintf(stderr, "  -T     timestamp every message for receiver -T latency stats\n");
+    fprintf(stderr, "  -F     hand off with spin-then-futex words in shared memory instead of named semaphores\n");
+    fprintf(stderr, "  -z     zero-copy: receiver mmaps the input, only (offset, length) pairs are sent\n");
+    fprintf(stderr, "  -S     put each line in a shared-memory slab block and send only its handle (no 1024-byte limit)\n");
+    fprintf(stderr, "  -K     CRC32C over every frame's payload, checked by the receiver\n");
+    fprintf(stderr, "  -H MS  send a heartbeat record whenever the input stalls for MS milliseconds\n");
+    fprintf(stderr, "  -P N   mode 4: N senders share the queue; receivers exit after all N finish\n");
+    fprintf(stderr, "  -R N   mode 9: wait for N receivers to attach before sending (default 1)\n");
+    fprintf(stderr, "  -C CH  mode 10: channel name (default lab1)\n");
+    fprintf(stderr, "  -c N, --cpu=N       pin the sending thread to CPU N\n");
+    fprintf(stderr, "  --busy-poll[=SPINS] spin on the ring index / handoff word instead of sleeping;\n"
+                    "                      with SPINS, fall back to blocking after that many pauses\n");
 }
 
+static const struct option long_opts[] = {
+    { "busy-poll", optional_argument, NULL, 'B' },
+    { "cpu",       required_argument, NULL, 'c' },
+    { NULL, 0, NULL, 0 },
+};
+
 int main(int argc, char *argv[])
 {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: ./sender <mode> <input.txt>\n");
+    int batch_max = 1, producers = 1, readers = 1, window = 1, cpu = -1, use_slab = 0, heartbeat_ms = 0;
+    long linger_us = 0, busy = 0;
+    const char *channel = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:l:w:TFzSKH:P:R:C:c:", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'b': batch_max = atoi(optarg); break;
+        case 'l': linger_us = atol(optarg); break;
+        case 'w': window = atoi(optarg); break;
+        case 'T': stamp = 1; break;
+        case 'F': sync_mode = SYNC_FUTEX; break;
+        case 'z': zero_copy = 1; break;
+        case 'S': use_slab = 1; break;
+        case 'K': checksum = 1; break;
+        case 'H': heartbeat_ms = atoi(optarg); break;
+        case 'P': producers = atoi(optarg); break;
+        case 'R': readers = atoi(optarg); break;
+        case 'C': channel = optarg; break;
+        case 'B': busy = optarg ? atol(optarg) : -1; break;
+        case 'c': cpu = atoi(optarg); break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
         return 1;
     }
 
     mailbox_t box;
-    box.flag = atoi(argv[1]);
-    const char *path = argv[2];
-
-    if (box.flag == MSG_PASSING)
-        puts("Message Passing");
-    else if (box.flag == SHARED_MEM)
-        puts("Shared Memory");
-    else {
-        fprintf(stderr, "Invalid mode. Use 1 or 2.\n");
+    if (!mailbox_lookup(argv[optind], &box)) {
+        fprintf(stderr, "Invalid mode: %s\n", argv[optind]);
+        usage();
         return 1;
     }
+    const char *path = argv[optind + 1];
+    box.batch_max = batch_max;
+    box.linger_us = linger_us;
+    box.producers = producers;
+    box.readers = readers;
+    if (channel)
+        box.channel = channel;
+    puts(box.ops->title);
 
-    cleanup_ipc();
-
-    sem_tx = sem_open(SEM_TX, O_CREAT | O_EXCL, 0644, 1);
-    sem_rx = sem_open(SEM_RX, O_CREAT | O_EXCL, 0644, 0);
-    if (sem_tx == SEM_FAILED || sem_rx == SEM_FAILED) {
-        perror("sem_open");
+    if (box.flag == MPMC_QUEUE && zero_copy) {
+        fprintf(stderr, "-z cannot be used with mode 4 (the map record would reach only one receiver)\n");
         return 1;
     }
+    if (zero_copy && !mailbox_uses_ctl(&box)) {
+        fprintf(stderr, "-z cannot be used with mode %d (no control segment to report that the receiver mapped the input)\n", box.flag);
+        return 1;
+    }
+    if (use_slab && zero_copy) {
+        fprintf(stderr, "-S and -z cannot be combined\n");
+        return 1;
+    }
+    if (use_slab && box.flag == BROADCAST) {
+        // lap 過的 receiver 不會 release 跳過的 block，-R 以外的 receiver 又會多 release
+        fprintf(stderr, "-S cannot be used with mode 9 (a lapped receiver never releases the blocks it skipped)\n");
+        return 1;
+    }
+    if (use_slab && box.flag == MPMC_QUEUE && producers > 1) {
+        fprintf(stderr, "-S cannot be used with -P > 1 (every sender would create its own arena)\n");
+        return 1;
+    }
+    if (batch_max > 1 && box.flag != MSG_PASSING)
+        fprintf(stderr, "-b only applies to mode 1, ignored\n");
+    if (window < 1) {
+        fprintf(stderr, "-w must be at least 1\n");
+        return 1;
+    }
+    if (box.flag == MSG_PASSING || box.flag == SHARED_MEM)
+        box.window = window;
+    else if (window > 1)
+        fprintf(stderr, "-w only applies to modes 1 and 2, ignored\n");
 
-    if (box.flag == MSG_PASSING) {
-        // 建立或取得一個message queue
-        int qid = msgget(MQ_KEY, 0666 | IPC_CREAT);
-        if (qid == -1) {
-            perror("msgget");
-            return 1;
+    // MPMC 有好幾個 sender、broadcast 有好幾個 receiver、channel 跟別的 pair 共用目錄：
+    // 都不能把別人的 IPC 清掉，也不用 control segment
+    if (mailbox_uses_ctl(&box)) {
+        cleanup_ipc();
+
+        if (sync_mode == SYNC_SEM) {
+            // sender 一開始就有 window 個 credit（lock-step 時是 1）
+            sem_tx = sem_open(SEM_TX, O_CREAT | O_EXCL, 0644, box.window);
+            sem_rx = sem_open(SEM_RX, O_CREAT | O_EXCL, 0644, 0);
+            if (sem_tx == SEM_FAILED || sem_rx == SEM_FAILED) {
+                perror("sem_open");
+                return 1;
+            }
         }
-        box.storage.msqid = qid;
-    } else if (box.flag == SHARED_MEM) {
-        // 建立一塊共享記憶體，大小跟一個 message 結構一樣。
-        int shmid = shmget(SHM_KEY, sizeof(message_t), 0666 | IPC_CREAT);
-        if (shmid == -1) {
-            perror("shmget");
+
+        // control segment：receiver 從這裡知道要用 semaphore 還是 futex
+        int ctlid = shmget(CTL_KEY, sizeof(ctl_t), 0666 | IPC_CREAT);
+        if (ctlid == -1) {
+            perror("shmget(ctl)");
             return 1;
         }
-        // 把這塊共享記憶體「附加（attach）」到目前這個 process 的位址空間
-        box.storage.shm_addr = (char *)shmat(shmid, NULL, 0);
-        if (box.storage.shm_addr == (char *)-1) {
-            perror("shmat");
+        ctl = (ctl_t *)shmat(ctlid, NULL, 0);
+        if (ctl == (ctl_t *)-1) {
+            perror("shmat(ctl)");
             return 1;
         }
+        ctl->sync = sync_mode;
+        ctl->window = box.window;
+        atomic_store(&ctl->tx.count, box.window);   // 跟 sem_tx 一樣從 window 開始
+        atomic_store(&ctl->rx.count, 0);
+        box.sync = sync_mode;
+        if (sync_mode == SYNC_FUTEX) {
+            handoff_init(&box.tx, NULL, &ctl->tx);
+            handoff_init(&box.rx, NULL, &ctl->rx);
+        } else {
+            handoff_init(&box.tx, sem_tx, NULL);
+            handoff_init(&box.rx, sem_rx, NULL);
+        }
     }
 
-    FILE *fp = fopen(path, "r");
-    if (!fp) {
-        perror("fopen");
+    if (use_slab && !(slab = slab_attach(1)))
         return 1;
-    }
 
-    message_t msg;
+    if (box.ops->open(&box, MB_SENDER) == -1)
+        return 1;
+    box.tx.busy = box.rx.busy = busy;
+    char label[STATS_NAME];
+    mailbox_label(&box, label, sizeof(label));
+    stats_open(&live, MB_SENDER, label, mailbox_depth, &box);
+
+    // 全部準備好才讓 receiver 開始
+    if (ctl)
+        atomic_store_explicit(&ctl->ready, 1, memory_order_release);
+
     size_t n_lines = 0;
-    
-    while (fgets(msg.msgText, sizeof(msg.msgText), fp)) {
-        msg.mType = 1;
-        send(msg, &box);
-        n_lines++;
-    }
+    reader_t rd;                // 非 -z 時的 input pipeline
+    double wall_sec = 0.0;
 
-    strcpy(msg.msgText, "EOF");
-    msg.mType = 1;
-    send(msg, &box);
+    // reader thread 讀檔、切行；這裡只負責把行送進 mailbox
+    if (!zero_copy && reader_start(&rd, path) == -1)
+        return 1;
+    // 只綁 main thread：reader thread 已經起來了，不會跟 busy poll 搶同一顆 CPU
+    if (cpu >= 0 && pin_to_cpu(cpu) == -1)
+        return 1;
 
-    // printf("\n[Sender] lines(incl. EOF)=%zu\n", n_lines + 1);
-    printf("\nEnd of input file! exit!\n");
-    printf("total IPC time(s) taken in sending msg = %.6f\n", total_sec);
+    if (zero_copy) {
+        n_lines = send_mapped(path, &box);
+    } else {
+        double t0 = mono_sec();
+
+        // 沒有長度上限，超過 1024 bytes 的行會被切成多個 frame
+        chunk_t *c;
+        for (;;) {
+            // 輸入停住（pipe / FIFO）超過 -H 毫秒就送 heartbeat，receiver 才知道我們還活著
+            // 有 batch 在等：輸入停住的話最多等到 -l 到期就先送出去
+            while (box.linger_us > 0 && box.batch_since > 0) {
+                long left = box.linger_us - (long)((mono_sec() - box.batch_since) * 1e6);
+                if (left > 0 && reader_wait(&rd, left))
+                    break;
+                flush(&box);
+            }
+            while (heartbeat_ms > 0 && !reader_wait(&rd, heartbeat_ms * 1000L)) {
+                send_control(REC_HEARTBEAT, &box);
+                flush(&box);
+            }
+            if (!(c = reader_next(&rd)))
+                break;
+            size_t start = 0;
+            for (size_t i = 0; i < c->n_lines; ++i) {
+                if (slab)
+                    send_slab(c->buf + start, c->ends[i] - start, &box);
+                else
+                    send_record(c->buf + start, c->ends[i] - start, &box);
+                start = c->ends[i];
+            }
+            n_lines += c->n_lines;
+            reader_release(&rd, c);
+        }
+        reader_stop(&rd);
+        wall_sec = mono_sec() - t0;
+
+        send_control(REC_END, &box);
+        flush(&box);
+    }
 
-    fclose(fp);
+    printf("\nEnd of input file! exit!\n");
+    printf("total IPC time(s) taken in sending msg = %.6f\n", box.ipc_sec);
+    if (box.flag == MSG_PASSING)
+        printf("messages per msgsnd = %.2f (%zu messages / %zu syscalls)\n",
+               box.n_syscalls ? (double)n_frames / box.n_syscalls : 0.0, n_frames, box.n_syscalls);
+    if (box.ops->uses_handoff)
+        handoff_report(box.sync, &box.tx, &box.rx);
+    if (!zero_copy)
+        reader_report(&rd, wall_sec);
 
-    sem_close(sem_tx);
-    sem_close(sem_rx);
+    stats_close(&live);
+    box.ops->close(&box, MB_SENDER);
+    if (slab)
+        slab_detach(slab);
 
-    if (box.flag == SHARED_MEM) {
-        shmdt(box.storage.shm_addr);
+    if (ctl) {
+        if (sync_mode == SYNC_SEM) {
+            sem_close(sem_tx);
+            sem_close(sem_rx);
+        }
+        shmdt(ctl);
     }
 
-    return 0;
+    return zc_unmapped;
 }
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
@@ -11,25 +12,10 @@
 #include <sys/shm.h>
 #include <semaphore.h>
 #include <time.h>
+#include "hist.h"
+#include "mailbox.h"
+#include "reader.h"
+#include "crc32c.h"
+#include "stats.h"
 
-#define MSG_PASSING 1
-#define SHARED_MEM 2
-
-typedef struct {
-    int flag;      // 1 for message passing, 2 for shared memory
-    union{
-        int msqid; //for system V api. You can replace it with structure for POSIX api
-        char* shm_addr;
-    }storage;
-} mailbox_t;
-
-
-typedef struct {
-    /*  TODO: 
-        Message structure for wrapper
-    */
-    long mType;
-    char msgText[1024];
-} message_t;
-
-void send(message_t message, mailbox_t* mailbox_ptr);
+void send(message_t* message_ptr, mailbox_t* mailbox_ptr);
@@ -0,0 +1,187 @@
+#include "slab.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define BLOCK(s, off)  ((slab_block_t *)((char *)(s) + (off)))
+
+static void remove_segment(void)
+{
+    int id = shmget(SLAB_KEY, 0, 0666);
+    if (id != -1)
+        shmctl(id, IPC_RMID, NULL);
+}
+
+slab_t *slab_attach(int create)
+{
+    int id;
+    if (create) {
+        // 上一輪沒清掉的 arena 直接砍掉，保證從全 0 開始
+        remove_segment();
+        id = shmget(SLAB_KEY, SLAB_SIZE, 0666 | IPC_CREAT | IPC_EXCL);
+    } else {
+        id = shmget(SLAB_KEY, 0, 0666);
+    }
+    if (id == -1) {
+        perror("shmget(slab)");
+        return NULL;
+    }
+
+    slab_t *s = (slab_t *)shmat(id, NULL, 0);
+    if (s == (slab_t *)-1) {
+        perror("shmat(slab)");
+        return NULL;
+    }
+
+    if (create) {
+        atomic_store_explicit(&s->brk, offsetof(slab_t, base), memory_order_relaxed);
+        atomic_store_explicit(&s->ready, 1, memory_order_release);
+    } else if (!atomic_load_explicit(&s->ready, memory_order_acquire)) {
+        // consumer 是看到 handle 才來 attach 的，這時候一定早就 ready 了
+        fprintf(stderr, "slab arena was never initialised\n");
+        shmdt(s);
+        return NULL;
+    }
+    atomic_fetch_add(&s->users, 1);
+    return s;
+}
+
+void slab_detach(slab_t *s)
+{
+    // 最後一個離開、而且沒有還沒 release 的 block 才刪；不然留給還沒 attach 的 receiver
+    if (atomic_fetch_sub(&s->users, 1) == 1 && atomic_load(&s->live) == 0)
+        remove_segment();
+    shmdt(s);
+}
+
+/* free list 的 head：高 32 bits 是 ABA tag，低 32 bits 是 block offset（0 = 空） */
+static void push_free(slab_t *s, unsigned cls, uint32_t off)
+{
+    _Atomic uint64_t *head = &s->free_head[cls];
+    uint64_t old = atomic_load_explicit(head, memory_order_relaxed);
+    uint64_t next;
+    do {
+        BLOCK(s, off)->next = (uint32_t)old;
+        next = ((old >> 32) + 1) << 32 | off;
+    } while (!atomic_compare_exchange_weak_explicit(head, &old, next,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static uint32_t pop_free(slab_t *s, unsigned cls)
+{
+    _Atomic uint64_t *head = &s->free_head[cls];
+    uint64_t old = atomic_load_explicit(head, memory_order_acquire);
+    while ((uint32_t)old) {
+        // 讀到的 next 可能已經過時，那 tag 一定也變了，CAS 會失敗重來
+        uint32_t link = BLOCK(s, (uint32_t)old)->next;
+        uint64_t next = ((old >> 32) + 1) << 32 | link;
+        if (atomic_compare_exchange_weak_explicit(head, &old, next,
+                                                  memory_order_acquire, memory_order_acquire))
+            return (uint32_t)old;
+    }
+    return 0;
+}
+
+static uint32_t carve(slab_t *s, size_t size)
+{
+    uint64_t off = atomic_load_explicit(&s->brk, memory_order_relaxed);
+    do {
+        if (off + size > SLAB_SIZE)
+            return 0;
+    } while (!atomic_compare_exchange_weak_explicit(&s->brk, &off, off + size,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    return (uint32_t)off;
+}
+
+/* 沒有剛好大小的：拆一個比較大的 free block，前面拿來用，後面一半一半放回小的 class */
+static uint32_t split_larger(slab_t *s, unsigned shift)
+{
+    for (unsigned k = shift + 1; k <= SLAB_MAX_SHIFT; ++k) {
+        uint32_t off = pop_free(s, k - SLAB_MIN_SHIFT);
+        if (!off)
+            continue;
+        while (k > shift) {
+            --k;
+            push_free(s, k - SLAB_MIN_SHIFT, off + (1u << k));
+        }
+        return off;
+    }
+    return 0;
+}
+
+static uint32_t find_block(slab_t *s, unsigned shift)
+{
+    uint32_t off = pop_free(s, shift - SLAB_MIN_SHIFT);
+    if (!off)
+        off = carve(s, 1ul << shift);
+    if (!off)
+        off = split_larger(s, shift);
+    return off;
+}
+
+void *slab_alloc(slab_t *s, size_t n, unsigned refs, uint64_t *handle)
+{
+    if (n > SLAB_MAX_PAYLOAD)
+        return NULL;
+    unsigned shift = SLAB_MIN_SHIFT;
+    while ((1ul << shift) < n + sizeof(slab_block_t))
+        shift++;
+
+    uint32_t off;
+    while (!(off = find_block(s, shift))) {
+        // arena 滿了：等 consumer release。先記下 event 值並登記，再試一次
+        int e = atomic_load(&s->free_evt);
+        atomic_fetch_add(&s->free_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ((off = find_block(s, shift))) {
+            atomic_fetch_sub(&s->free_waiters, 1);
+            break;
+        }
+        // 沒有人拿著 block 就不會有 release：free 的都太小（不會合併），等下去是死等
+        if (atomic_load(&s->live) == 0) {
+            atomic_fetch_sub(&s->free_waiters, 1);
+            return NULL;
+        }
+        futex_wait(&s->free_evt, e);
+        atomic_fetch_sub(&s->free_waiters, 1);
+    }
+
+    slab_block_t *b = BLOCK(s, off);
+    b->shift = shift;
+    b->len = (uint32_t)n;
+    atomic_store_explicit(&b->refs, refs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->live, 1, memory_order_relaxed);
+    *handle = off;
+    return b + 1;
+}
+
+void *slab_payload(slab_t *s, uint64_t handle, size_t *len)
+{
+    if (handle < offsetof(slab_t, base) || handle > SLAB_SIZE - sizeof(slab_block_t))
+        return NULL;
+    slab_block_t *b = BLOCK(s, handle);
+    if (b->shift < SLAB_MIN_SHIFT || b->shift > SLAB_MAX_SHIFT ||
+        handle + (1ul << b->shift) > SLAB_SIZE || b->len > (1ul << b->shift) - sizeof(*b))
+        return NULL;
+    *len = b->len;
+    return b + 1;
+}
+
+void slab_release(slab_t *s, uint64_t handle)
+{
+    slab_block_t *b = BLOCK(s, handle);
+    if (atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) != 1)
+        return;
+    push_free(s, b->shift - SLAB_MIN_SHIFT, (uint32_t)handle);
+    atomic_fetch_sub(&s->live, 1);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&s->free_waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&s->free_evt, 1);
+        futex_wake(&s->free_evt, INT_MAX);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "ring.h"
+
+#define SLAB_KEY        0x88C0DE
+#define SLAB_SIZE       (64u << 20)     // bytes in the arena segment
+#define SLAB_MIN_SHIFT  6               // smallest block: 64 bytes
+#define SLAB_MAX_SHIFT  24              // largest block: 16 MB
+#define SLAB_CLASSES    (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+
+/*
+ * Shared-memory arena for variable-size payloads. Blocks are powers of two
+ * from 64 bytes to 16 MB; each size class has a lock-free free list (a
+ * Treiber stack whose head packs a 32-bit ABA tag with the 32-bit block
+ * offset). A class with an empty list carves a new block off `brk`, or
+ * once the arena is used up splits a free block of a larger class in
+ * halves. Free blocks are never merged again.
+ *
+ * A block starts with a slab_block_t header. The producer writes the
+ * payload in place and publishes only the block's offset (its handle);
+ * every consumer calls slab_release() when done, and the block goes back
+ * on its free list when `refs` reaches zero.
+ *
+ * The segment is removed by the last process to detach once no block is
+ * allocated any more, so a receiver that attaches after the sender exited
+ * still finds the payloads it was sent.
+ */
+typedef struct {
+    uint32_t shift;             // size class: block is 1 << shift bytes
+    uint32_t next;              // free list link (offset), only while free
+    _Atomic uint32_t refs;      // consumers that still have to release it
+    uint32_t len;               // payload bytes
+} slab_block_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic int ready;
+    _Atomic int users;          // attached processes
+    _Atomic uint64_t live;      // allocated blocks
+    _Atomic uint64_t brk;       // first byte never handed out
+
+    _Alignas(CACHE_LINE) _Atomic uint64_t free_head[SLAB_CLASSES];
+
+    // futex event counter: bumped on release when an allocator waits for space
+    _Alignas(CACHE_LINE) _Atomic int free_evt;
+    _Atomic int free_waiters;
+
+    _Alignas(CACHE_LINE) char base[];  // blocks start here
+} slab_t;
+
+#define SLAB_MAX_PAYLOAD  ((1u << SLAB_MAX_SHIFT) - sizeof(slab_block_t))
+
+/*
+ * Producer (create != 0): create a fresh arena, removing a stale one.
+ * Consumer: attach to the existing one. Returns NULL on failure.
+ */
+slab_t *slab_attach(int create);
+void slab_detach(slab_t *s);
+
+/*
+ * Allocate room for n payload bytes to be released by `refs` consumers.
+ * Blocks while the arena is full and some block is still allocated;
+ * returns NULL if n > SLAB_MAX_PAYLOAD or if no block can ever fit.
+ */
+void *slab_alloc(slab_t *s, size_t n, unsigned refs, uint64_t *handle);
+
+// Payload of a published block, and its length.
+void *slab_payload(slab_t *s, uint64_t handle, size_t *len);
+
+// Drop one reference; the block is freed when the last one is gone.
+void slab_release(slab_t *s, uint64_t handle);
+
+#endif
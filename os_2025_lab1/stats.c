@@ -0,0 +1,125 @@
+#include "stats.h"
+#include "hist.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+// 拿不到 page 或 slot 時計數器寫到這裡，hot path 不用判斷 NULL
+static stats_slot_t dummy_slot;
+
+static int is_gone(pid_t pid)
+{
+    return pid != 0 && kill(pid, 0) == -1 && errno == ESRCH;
+}
+
+static stats_slot_t *claim(stats_page_t *page, pid_t me)
+{
+    for (int i = 0; i < STATS_SLOTS; ++i) {
+        stats_slot_t *s = &page->slots[i];
+        int pid = atomic_load(&s->pid);
+        // 空的，或是上一個主人沒 release 就死了
+        if ((pid == 0 || is_gone(pid)) && atomic_compare_exchange_strong(&s->pid, &pid, me))
+            return s;
+    }
+    return NULL;
+}
+
+static void *sampler(void *arg)
+{
+    stats_t *st = arg;
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+
+    pthread_mutex_lock(&st->lock);
+    while (!st->stop) {
+        long d = st->depth ? st->depth(st->arg) : -1;
+        atomic_store_explicit(&st->slot->depth, d, memory_order_relaxed);
+        until.tv_sec++;
+        while (!st->stop && pthread_cond_timedwait(&st->cv, &st->lock, &until) != ETIMEDOUT)
+            ;
+    }
+    pthread_mutex_unlock(&st->lock);
+    return NULL;
+}
+
+void stats_open(stats_t *st, int role, const char *mode, long (*depth)(void *), void *arg)
+{
+    memset(st, 0, sizeof(*st));
+    st->slot = &dummy_slot;
+    st->depth = depth;
+    st->arg = arg;
+
+    int id = shmget(STATS_KEY, sizeof(stats_page_t), 0666 | IPC_CREAT);
+    if (id == -1) {
+        perror("shmget(stats), live stats disabled");
+        return;
+    }
+    stats_page_t *page = (stats_page_t *)shmat(id, NULL, 0);
+    if (page == (stats_page_t *)-1) {
+        perror("shmat(stats), live stats disabled");
+        return;
+    }
+    stats_slot_t *s = claim(page, getpid());
+    if (!s) {
+        fprintf(stderr, "stats page is full (%d processes), live stats disabled\n", STATS_SLOTS);
+        shmdt(page);
+        return;
+    }
+
+    // ready = 0 的時候 ipcstat 不會看其他欄位
+    atomic_store(&s->ready, 0);
+    s->role = role;
+    snprintf(s->mode, sizeof(s->mode), "%s", mode);
+    s->start_ns = now_ns();
+    atomic_store_explicit(&s->frames, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->ipc_ns, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->blocked_ns, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->depth, -1, memory_order_relaxed);
+    atomic_store_explicit(&s->ready, 1, memory_order_release);
+    st->page = page;
+    st->slot = s;
+
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->cv, NULL);
+    if (pthread_create(&st->thread, NULL, sampler, st) != 0)
+        fprintf(stderr, "pthread_create(stats sampler) failed, queue depth not published\n");
+    else
+        st->running = 1;
+}
+
+void stats_close(stats_t *st)
+{
+    if (st->running) {
+        pthread_mutex_lock(&st->lock);
+        st->stop = 1;
+        pthread_cond_signal(&st->cv);
+        pthread_mutex_unlock(&st->lock);
+        pthread_join(st->thread, NULL);
+        pthread_mutex_destroy(&st->lock);
+        pthread_cond_destroy(&st->cv);
+        st->running = 0;
+    }
+    if (st->slot == &dummy_slot)
+        return;
+
+    atomic_store(&st->slot->ready, 0);
+    atomic_store(&st->slot->pid, 0);
+    shmdt(st->page);
+    st->slot = &dummy_slot;
+    st->page = NULL;
+}
+
+const stats_page_t *stats_attach_ro(void)
+{
+    int id = shmget(STATS_KEY, 0, 0);
+    if (id == -1)
+        return NULL;
+    const stats_page_t *page = shmat(id, NULL, SHM_RDONLY);
+    return page == (void *)-1 ? NULL : page;
+}
@@ -0,0 +1,80 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "ring.h"
+
+#define STATS_KEY    0x99C0DE
+#define STATS_SLOTS  128        // processes that can publish at the same time
+#define STATS_NAME   48         // mode name (plus channel), including the NUL
+
+/*
+ * Live counters of one sender or receiver. Only the owning process writes
+ * its slot, so the hot path updates it with plain relaxed stores (no
+ * read-modify-write, no lock); ipcstat maps the page read-only and turns
+ * the counters into rates. Each slot has its own cache lines, so publishers
+ * never share a line with each other.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic int pid;   // owner, 0 if the slot is free
+    _Atomic int ready;                      // the fields below describe the owner
+    int role;                               // MB_SENDER / MB_RECEIVER
+    char mode[STATS_NAME];
+    uint64_t start_ns;                      // now_ns() when the slot was claimed
+
+    _Alignas(CACHE_LINE) _Atomic uint64_t frames;   // frames through the transport
+    _Atomic uint64_t bytes;                         // their header + payload bytes
+    _Atomic uint64_t ipc_ns;                        // time inside send() / recv()
+    _Atomic uint64_t blocked_ns;                    // time asleep in handoff waits
+    _Atomic int64_t depth;                          // frames queued, -1 if unknown (sampler)
+} stats_slot_t;
+
+/*
+ * The stats page (STATS_KEY). A new segment is all zeroes, i.e. every slot
+ * is free, so nobody has to initialise it. A slot is claimed with a CAS on
+ * pid; slots of processes that died without releasing them are taken over.
+ * The page stays around between runs, like /proc; `ipcrm -M 0x99C0DE`
+ * removes it.
+ */
+typedef struct {
+    stats_slot_t slots[STATS_SLOTS];
+} stats_page_t;
+
+// A publisher: its slot plus the thread that samples the queue depth once a second.
+typedef struct {
+    stats_page_t *page;
+    stats_slot_t *slot;
+    long (*depth)(void *arg);
+    void *arg;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    int running, stop;
+} stats_t;
+
+/*
+ * Claim a slot and start the depth sampler (depth may be NULL). Never
+ * fails: without a page or a free slot the counters go to a private dummy
+ * slot and a warning is printed.
+ */
+void stats_open(stats_t *st, int role, const char *mode, long (*depth)(void *), void *arg);
+void stats_close(stats_t *st);
+
+// ipcstat: the page mapped read-only, or NULL if nobody has created it yet.
+const stats_page_t *stats_attach_ro(void);
+
+static inline void stats_count(stats_slot_t *s, size_t bytes, double ipc_sec, uint64_t blocked_ns)
+{
+    // 只有自己會寫這個 slot：load + store 就夠了，不用 atomic add
+    atomic_store_explicit(&s->frames, atomic_load_explicit(&s->frames, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&s->bytes, atomic_load_explicit(&s->bytes, memory_order_relaxed) + bytes,
+                          memory_order_relaxed);
+    atomic_store_explicit(&s->ipc_ns, (uint64_t)(ipc_sec * 1e9), memory_order_relaxed);
+    atomic_store_explicit(&s->blocked_ns, blocked_ns, memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,510 @@
+/*
+ * Kernel-buffered transports (modes 5-7) and the eventfd ring (mode 8).
+ *
+ * Modes 5-7 need no handoff: the kernel object itself blocks the reader
+ * while it is empty and the writer while it is full. The sender opens the
+ * object before it sets ctl->ready; anything that needs the receiver to be
+ * present (opening the FIFO for writing, accept()) is deferred to the first
+ * send so neither side deadlocks waiting for the other.
+ */
+#include "mailbox.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define FIFO_PATH    "/tmp/lab1_fifo"
+#define SOCK_PATH    "/tmp/lab1.sock"
+#define EFD_SOCK     "/tmp/lab1_efd.sock"
+#define PMQ_NAME     "/lab1_mq"
+#define PMQ_MAXMSG   10          // default /proc/sys/fs/mqueue/msg_max
+
+#define FRAME_HDR    (MSG_HDR_SIZE - sizeof(long))   // everything but mType is sent
+
+static void write_all(int fd, const void *buf, size_t n, const char *what)
+{
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            perror(what);
+            exit(1);
+        }
+        p += w;
+        n -= w;
+    }
+}
+
+static int listen_unix(int type, const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, type, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 1) == -1) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* sender: mb->priv 先放 listening socket，第一次 send 才 accept */
+static int listen_later(mailbox_t *mb, int type, const char *path)
+{
+    int *lfd = malloc(sizeof(int));
+    if (!lfd) {
+        perror("malloc");
+        return -1;
+    }
+    *lfd = listen_unix(type, path);
+    if (*lfd < 0) {
+        free(lfd);
+        return -1;
+    }
+    mb->priv = lfd;
+    return 0;
+}
+
+/* 等 receiver 連進來，之後就不需要 listening socket 跟路徑了 */
+static int accept_peer(mailbox_t *mb, const char *path)
+{
+    int *lfd = mb->priv, fd;
+    while ((fd = accept(*lfd, NULL, NULL)) < 0) {
+        if (errno != EINTR) {
+            perror("accept");
+            exit(1);
+        }
+    }
+    close(*lfd);
+    free(lfd);
+    mb->priv = NULL;
+    unlink(path);
+    return fd;
+}
+
+/* 沒有人連進來過就結束了 */
+static void drop_listener(mailbox_t *mb, const char *path)
+{
+    int *lfd = mb->priv;
+    if (lfd) {
+        close(*lfd);
+        free(lfd);
+        mb->priv = NULL;
+    }
+    unlink(path);
+}
+
+// Receiver 跟 open_semaphore_with_retry() 一樣：sender 還沒 listen 就等一下再試
+static int connect_with_retry(int type, const char *path, int max_retry, int retry_ms)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    for (int i = 0; i <= max_retry; ++i) {
+        int fd = socket(AF_UNIX, type, 0);
+        if (fd < 0) {
+            perror("socket");
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+            return fd;
+        int err = errno;
+        close(fd);
+        if (err != ENOENT && err != ECONNREFUSED) {
+            errno = err;
+            perror(path);
+            return -1;
+        }
+        usleep(retry_ms * 1000);
+    }
+    fprintf(stderr, "%s: sender is not listening\n", path);
+    return -1;
+}
+
+/* ---------------- 5: named pipe ---------------- */
+
+// pipe 是 byte stream：receiver 一次 read 64KB 再自己切 frame
+struct fifo_state {
+    size_t off, end;
+    char buf[1 << 16];
+};
+
+static int fifo_open(mailbox_t *mb, int role)
+{
+    mb->storage.fd = -1;
+    if (role == MB_SENDER) {
+        // 兩個 process 沒有親屬關係，pipe() 的 fd 傳不過去，所以用有名字的 FIFO
+        unlink(FIFO_PATH);
+        if (mkfifo(FIFO_PATH, 0666) == -1) {
+            perror("mkfifo");
+            return -1;
+        }
+        return 0;
+    }
+
+    mb->priv = calloc(1, sizeof(struct fifo_state));
+    if (!mb->priv) {
+        perror("calloc");
+        return -1;
+    }
+    // 會等到 sender 第一次 send() 把寫端打開
+    mb->storage.fd = open(FIFO_PATH, O_RDONLY);
+    if (mb->storage.fd < 0) {
+        perror(FIFO_PATH);
+        return -1;
+    }
+    return 0;
+}
+
+static void fifo_send(mailbox_t *mb, const message_t *msg)
+{
+    if (mb->storage.fd < 0) {
+        mb->storage.fd = open(FIFO_PATH, O_WRONLY);
+        if (mb->storage.fd < 0) {
+            perror(FIFO_PATH);
+            exit(1);
+        }
+    }
+    double t0 = mono_sec();
+    // 一個 frame 不到 PIPE_BUF，一次 write() 就是 atomic 的
+    write_all(mb->storage.fd, MSG_FRAME(msg), MSG_BODY(msg), "write(fifo)");
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void fifo_read(mailbox_t *mb, void *dst, size_t n)
+{
+    struct fifo_state *st = mb->priv;
+    char *p = dst;
+    while (n > 0) {
+        if (st->off == st->end) {
+            ssize_t r = read(mb->storage.fd, st->buf, sizeof(st->buf));
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0) {
+                fprintf(stderr, "[Receiver] fifo closed before EOF\n");
+                exit(1);
+            }
+            st->off = 0;
+            st->end = r;
+        }
+        size_t chunk = st->end - st->off < n ? st->end - st->off : n;
+        memcpy(p, st->buf + st->off, chunk);
+        st->off += chunk;
+        p += chunk;
+        n -= chunk;
+    }
+}
+
+static void fifo_recv(mailbox_t *mb, message_t *msg)
+{
+    double t0 = mono_sec();
+    msg->mType = 1;
+    fifo_read(mb, MSG_FRAME(msg), FRAME_HDR);
+    if (msg->len > sizeof(msg->msgText)) {
+        fprintf(stderr, "[Receiver] corrupt frame in fifo\n");
+        exit(1);
+    }
+    fifo_read(mb, msg->msgText, msg->len);
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void fifo_close(mailbox_t *mb, int role)
+{
+    if (mb->storage.fd >= 0)
+        close(mb->storage.fd);
+    if (role == MB_RECEIVER)
+        unlink(FIFO_PATH);
+    free(mb->priv);
+}
+
+static void fifo_cleanup(void)
+{
+    unlink(FIFO_PATH);
+}
+
+const mailbox_ops_t mailbox_fifo = {
+    "fifo", "FIFO", 0,
+    fifo_open, fifo_send, fifo_recv, NULL, fifo_close, fifo_cleanup,
+};
+
+/* ---------------- 6: AF_UNIX SOCK_SEQPACKET ---------------- */
+
+// SOCK_SEQPACKET 保留訊息邊界，一個 frame 一次 write / read
+
+static int sock_open(mailbox_t *mb, int role)
+{
+    mb->storage.fd = -1;
+    if (role == MB_SENDER)
+        return listen_later(mb, SOCK_SEQPACKET, SOCK_PATH);
+    mb->storage.fd = connect_with_retry(SOCK_SEQPACKET, SOCK_PATH, 50, 20);
+    return mb->storage.fd < 0 ? -1 : 0;
+}
+
+static void sock_send(mailbox_t *mb, const message_t *msg)
+{
+    if (mb->storage.fd < 0)
+        mb->storage.fd = accept_peer(mb, SOCK_PATH);
+    double t0 = mono_sec();
+    while (write(mb->storage.fd, MSG_FRAME(msg), MSG_BODY(msg)) < 0) {
+        if (errno != EINTR) {
+            perror("write(socket)");
+            exit(1);
+        }
+    }
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void sock_recv(mailbox_t *mb, message_t *msg)
+{
+    double t0 = mono_sec();
+    ssize_t n;
+    while ((n = read(mb->storage.fd, MSG_FRAME(msg), sizeof(*msg) - sizeof(long))) < 0) {
+        if (errno != EINTR) {
+            perror("read(socket)");
+            exit(1);
+        }
+    }
+    if (n < (ssize_t)FRAME_HDR || (size_t)n != FRAME_HDR + msg->len) {
+        fprintf(stderr, "[Receiver] %s\n", n == 0 ? "socket closed before EOF" : "corrupt frame on socket");
+        exit(1);
+    }
+    msg->mType = 1;
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void sock_close(mailbox_t *mb, int role)
+{
+    if (mb->storage.fd >= 0)
+        close(mb->storage.fd);
+    if (role == MB_SENDER)
+        drop_listener(mb, SOCK_PATH);
+}
+
+static void sock_cleanup(void)
+{
+    unlink(SOCK_PATH);
+}
+
+const mailbox_ops_t mailbox_socket = {
+    "unix_socket", "UNIX Socket (SOCK_SEQPACKET)", 0,
+    sock_open, sock_send, sock_recv, NULL, sock_close, sock_cleanup,
+};
+
+/* ---------------- 7: POSIX message queue ---------------- */
+
+// mq_receive() 的 buffer 至少要 mq_msgsize，系統預設的可能比 message_t 大
+struct pmq_state {
+    size_t msgsize;
+    char *buf;                   // NULL when a message_t is large enough
+};
+
+static int pmq_open(mailbox_t *mb, int role)
+{
+    mqd_t mq;
+    if (role == MB_SENDER) {
+        struct mq_attr attr = { .mq_maxmsg = PMQ_MAXMSG, .mq_msgsize = sizeof(message_t) - sizeof(long) };
+        mq_unlink(PMQ_NAME);
+        mq = mq_open(PMQ_NAME, O_CREAT | O_EXCL | O_WRONLY, 0666, &attr);
+        if (mq == (mqd_t)-1 && errno == EINVAL)   // 超過 fs.mqueue 的上限就用系統預設
+            mq = mq_open(PMQ_NAME, O_CREAT | O_EXCL | O_WRONLY, 0666, NULL);
+    } else {
+        // queue 在 ctl->ready 之前就建好了
+        mq = mq_open(PMQ_NAME, O_RDONLY);
+    }
+    if (mq == (mqd_t)-1) {
+        perror("mq_open");
+        return -1;
+    }
+    mb->storage.fd = (int)mq;
+
+    if (role == MB_RECEIVER) {
+        struct mq_attr attr;
+        struct pmq_state *st = calloc(1, sizeof(*st));
+        if (!st || mq_getattr(mq, &attr) == -1) {
+            perror("mq_getattr");
+            return -1;
+        }
+        mb->priv = st;
+        st->msgsize = attr.mq_msgsize;
+        if (st->msgsize > sizeof(message_t) - sizeof(long) && !(st->buf = malloc(st->msgsize))) {
+            perror("malloc");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void pmq_send(mailbox_t *mb, const message_t *msg)
+{
+    double t0 = mono_sec();
+    while (mq_send((mqd_t)mb->storage.fd, MSG_FRAME(msg), MSG_BODY(msg), 0) == -1) {
+        if (errno != EINTR) {
+            perror("mq_send");
+            exit(1);
+        }
+    }
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void pmq_recv(mailbox_t *mb, message_t *msg)
+{
+    struct pmq_state *st = mb->priv;
+    double t0 = mono_sec();
+    char *dst = st->buf ? st->buf : MSG_FRAME(msg);
+    ssize_t n;
+    while ((n = mq_receive((mqd_t)mb->storage.fd, dst, st->msgsize, NULL)) == -1) {
+        if (errno != EINTR) {
+            perror("mq_receive");
+            exit(1);
+        }
+    }
+    if (n < (ssize_t)FRAME_HDR || n > (ssize_t)(sizeof(*msg) - sizeof(long))) {
+        fprintf(stderr, "[Receiver] corrupt frame in mqueue\n");
+        exit(1);
+    }
+    if (st->buf)
+        memcpy(MSG_FRAME(msg), dst, n);
+    msg->mType = 1;
+    mb->ipc_sec += mono_sec() - t0;
+}
+
+static void pmq_close(mailbox_t *mb, int role)
+{
+    struct pmq_state *st = mb->priv;
+    mq_close((mqd_t)mb->storage.fd);
+    if (role == MB_RECEIVER)
+        mq_unlink(PMQ_NAME);
+    if (st) {
+        free(st->buf);
+        free(st);
+    }
+}
+
+static long pmq_depth(mailbox_t *mb)
+{
+    struct mq_attr attr;
+    return mq_getattr((mqd_t)mb->storage.fd, &attr) == -1 ? -1 : attr.mq_curmsgs;
+}
+
+static void pmq_cleanup(void)
+{
+    if (mq_unlink(PMQ_NAME) == 0)
+        printf("[Cleanup] Removed old POSIX message queue (%s)\n", PMQ_NAME);
+}
+
+const mailbox_ops_t mailbox_posix_mq = {
+    "posix_mq", "POSIX Message Queue", 0,
+    pmq_open, pmq_send, pmq_recv, NULL, pmq_close, pmq_cleanup, pmq_depth,
+};
+
+/* ---------------- 8: ring + eventfd ---------------- */
+
+/*
+ * Same SPSC ring as mode 3, but a side that has to park blocks in read()
+ * on an EFD_SEMAPHORE eventfd instead of a semaphore / futex. The sender
+ * creates both eventfds and hands them to the receiver over a unix socket
+ * with SCM_RIGHTS (an eventfd cannot be re-opened through /proc/<pid>/fd).
+ */
+
+static int efd_open(mailbox_t *mb, int role)
+{
+    if (ring_box_open(mb, role) == -1)
+        return -1;
+
+    int fds[2];
+    if (role == MB_SENDER) {
+        fds[0] = eventfd(0, EFD_SEMAPHORE);   // space: sender waits on tx
+        fds[1] = eventfd(0, EFD_SEMAPHORE);   // data: receiver waits on rx
+        if (fds[0] < 0 || fds[1] < 0) {
+            perror("eventfd");
+            return -1;
+        }
+        if (listen_later(mb, SOCK_STREAM, EFD_SOCK) == -1)
+            return -1;
+    } else {
+        int fd = connect_with_retry(SOCK_STREAM, EFD_SOCK, 50, 20);
+        if (fd < 0)
+            return -1;
+
+        char byte;
+        struct iovec iov = { &byte, 1 };
+        union { struct cmsghdr h; char buf[CMSG_SPACE(sizeof(fds))]; } ctrl;
+        struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1,
+                             .msg_control = ctrl.buf, .msg_controllen = sizeof(ctrl.buf) };
+        struct cmsghdr *cm;
+        if (recvmsg(fd, &mh, 0) != 1 || !(cm = CMSG_FIRSTHDR(&mh)) ||
+            cm->cmsg_type != SCM_RIGHTS || cm->cmsg_len != CMSG_LEN(sizeof(fds))) {
+            fprintf(stderr, "[Receiver] did not get the eventfds from the sender\n");
+            return -1;
+        }
+        memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+        close(fd);
+    }
+
+    handoff_init_eventfd(&mb->tx, fds[0]);
+    handoff_init_eventfd(&mb->rx, fds[1]);
+    mb->sync = SYNC_EVENTFD;
+    return 0;
+}
+
+/* 第一次 send 之前把兩個 eventfd 交給 receiver（ring 是空的，不會先睡在 eventfd 上） */
+static void efd_give(mailbox_t *mb)
+{
+    int fd = accept_peer(mb, EFD_SOCK);
+    int fds[2] = { mb->tx.efd, mb->rx.efd };
+
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    union { struct cmsghdr h; char buf[CMSG_SPACE(sizeof(fds))]; } ctrl;
+    struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1,
+                         .msg_control = ctrl.buf, .msg_controllen = sizeof(ctrl.buf) };
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    if (sendmsg(fd, &mh, 0) != 1) {
+        perror("sendmsg(SCM_RIGHTS)");
+        exit(1);
+    }
+    close(fd);
+}
+
+static void efd_send(mailbox_t *mb, const message_t *msg)
+{
+    if (mb->priv)
+        efd_give(mb);
+    ring_box_send(mb, msg);
+}
+
+static void efd_close(mailbox_t *mb, int role)
+{
+    if (role == MB_SENDER)
+        drop_listener(mb, EFD_SOCK);
+    close(mb->tx.efd);
+    close(mb->rx.efd);
+    ring_box_close(mb, role);
+}
+
+static void efd_cleanup(void)
+{
+    unlink(EFD_SOCK);
+}
+
+const mailbox_ops_t mailbox_eventfd = {
+    "eventfd_ring", "Ring Buffer + eventfd", 1,
+    efd_open, efd_send, ring_box_recv, NULL, efd_close, efd_cleanup, ring_box_depth,
+};
@@ -0,0 +1,161 @@
+/*
+ * Run every transport through the receiver -T / -J harness at several
+ * message sizes and print one table, so the fastest transport per size can
+ * be picked from measurements on the machine at hand:
+ *
+ *   ./transport_bench [-m 1,2,3,5,6,7,8,10] [-s 16,256,1024,4096] [-n lines]
+ *                     [-c sender_cpu,receiver_cpu] [-B spins]
+ *
+ * Each size gets a generated input of `lines` lines of that many bytes
+ * (newline included); lines longer than 1024 bytes travel as several frames.
+ * Mode 4 is left out by default because it needs the queue to be created
+ * first (see mpmc_bench). -c pins the two sides (same core, sibling, other
+ * socket ...) and -B passes --busy-poll=spins to both (-1: never block).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+#define MAX_ITEMS  16
+#define INPUT_PATH "/tmp/transport_bench.txt"
+#define JSON_PATH  "/tmp/transport_bench.json"
+
+static char *cpus[2];           // -c: --cpu for sender / receiver
+static char busy_arg[32];       // -B: --busy-poll=N for both
+
+// 原地切分 s（optarg 指向可写的 argv），out 中的各项直接指向 s
+static int parse_list(char *s, char **out, int max)
+{
+    int n = 0;
+    for (char *tok = strtok(s, ","); tok && n < max; tok = strtok(NULL, ","))
+        out[n++] = tok;
+    return n;
+}
+
+static void make_input(const char *path, long size, long lines)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    char *line = malloc(size);
+    for (long i = 0; i < lines; ++i) {
+        for (long j = 0; j < size - 1; ++j)
+            line[j] = 'a' + (i + j) % 26;
+        line[size - 1] = '\n';
+        fwrite(line, 1, size, fp);
+    }
+    free(line);
+    fclose(fp);
+}
+
+static double json_number(const char *json, const char *key)
+{
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char *p = strstr(json, pat);
+    return p ? atof(p + strlen(pat)) : 0.0;
+}
+
+// 一次 sender -T + receiver -J，結果從 JSON 讀回來
+static int run_once(const char *mode, char *json, size_t cap)
+{
+    unlink(JSON_PATH);
+
+    char *sargv[10] = { "./sender", "-T" }, *rargv[10] = { "./receiver", "-J", JSON_PATH };
+    int ns = 2, nr = 3;
+    if (cpus[0]) {
+        sargv[ns++] = "-c";
+        sargv[ns++] = cpus[0];
+    }
+    if (cpus[1]) {
+        rargv[nr++] = "-c";
+        rargv[nr++] = cpus[1];
+    }
+    if (busy_arg[0]) {
+        sargv[ns++] = busy_arg;
+        rargv[nr++] = busy_arg;
+    }
+    sargv[ns++] = (char *)mode;
+    sargv[ns++] = INPUT_PATH;
+    rargv[nr++] = (char *)mode;
+    bench_launch(sargv);
+    bench_launch(rargv);
+
+    int status, failed = 0;
+    while (wait(&status) > 0)
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+
+    FILE *fp = fopen(JSON_PATH, "r");
+    if (failed || !fp) {
+        if (fp)
+            fclose(fp);
+        return -1;
+    }
+    size_t n = fread(json, 1, cap - 1, fp);
+    json[n] = '\0';
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char *modes[MAX_ITEMS] = { "1", "2", "3", "5", "6", "7", "8", "10" };
+    char *sizes[MAX_ITEMS] = { "16", "256", "1024", "4096" };
+    int n_modes = 8, n_sizes = 4;
+    long lines = 100000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:s:n:c:B:")) != -1) {
+        switch (opt) {
+        case 'm': n_modes = parse_list(optarg, modes, MAX_ITEMS); break;
+        case 's': n_sizes = parse_list(optarg, sizes, MAX_ITEMS); break;
+        case 'n': lines = atol(optarg); break;
+        case 'c':
+            if (parse_list(optarg, cpus, 2) != 2) {
+                fprintf(stderr, "-c needs two CPUs: sender,receiver\n");
+                return 1;
+            }
+            break;
+        case 'B': snprintf(busy_arg, sizeof(busy_arg), "--busy-poll=%s", optarg); break;
+        default:
+            fprintf(stderr, "Usage: ./transport_bench [-m 1,2,3,5,6,7,8,10] [-s 16,256,1024,4096] [-n lines]\n"
+                            "                         [-c sender_cpu,receiver_cpu] [-B spins]\n");
+            return 1;
+        }
+    }
+
+    printf("%6s %-14s %12s %10s %10s %10s %10s\n",
+           "bytes", "transport", "msg/s", "MB/s", "p50(ns)", "p99(ns)", "max(ns)");
+    for (int i = 0; i < n_sizes; ++i) {
+        long size = atol(sizes[i]);
+        if (size < 1)
+            continue;
+        make_input(INPUT_PATH, size, lines);
+
+        for (int j = 0; j < n_modes; ++j) {
+            char json[4096];
+            if (run_once(modes[j], json, sizeof(json)) == -1) {
+                printf("%6ld %-14s %12s\n", size, modes[j], "failed");
+                continue;
+            }
+            char name[32] = "?";
+            const char *t = strstr(json, "\"transport\":\"");
+            if (t)
+                sscanf(t + strlen("\"transport\":\""), "%31[^\"]", name);
+            printf("%6ld %-14s %12.0f %10.2f %10.0f %10.0f %10.0f\n", size, name,
+                   json_number(json, "msgs_per_sec"), json_number(json, "mb_per_sec"),
+                   json_number(json, "p50"), json_number(json, "p99"), json_number(json, "max"));
+            fflush(stdout);
+        }
+    }
+    unlink(INPUT_PATH);
+    unlink(JSON_PATH);
+    return 0;
+}
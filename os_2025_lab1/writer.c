@@ -0,0 +1,146 @@
+#include "writer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// 兩邊都在同一個 process 裡，用 PRIVATE futex 就好
+static void wait_evt(_Atomic int *evt, int expected, int timeout_ms)
+{
+    struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, (int *)evt, FUTEX_WAIT_PRIVATE, expected,
+            timeout_ms > 0 ? &ts : NULL, NULL, 0);
+}
+
+static void signal_evt(_Atomic int *evt)
+{
+    atomic_fetch_add(evt, 1);
+    syscall(SYS_futex, (int *)evt, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void *writer_main(void *arg)
+{
+    writer_t *w = arg;
+    uint64_t t = atomic_load_explicit(&w->tail, memory_order_relaxed);
+
+    for (;;) {
+        uint64_t h = atomic_load_explicit(&w->head, memory_order_acquire);
+        if (h == t) {
+            if (atomic_load_explicit(&w->done, memory_order_acquire) &&
+                atomic_load_explicit(&w->head, memory_order_acquire) == t)
+                break;
+            // 先登記再看一次 head，producer 看到 writer_waiting 才會叫醒我們
+            int e = atomic_load(&w->data_evt);
+            atomic_store(&w->writer_waiting, 1);
+            if (atomic_load(&w->head) == t && !atomic_load(&w->done))
+                wait_evt(&w->data_evt, e, WRITER_LINGER);
+            atomic_store_explicit(&w->writer_waiting, 0, memory_order_relaxed);
+            continue;
+        }
+
+        // [t, h) 在 ring 裡可能繞回開頭，分兩段一次 writev 出去
+        size_t off = t & (WRITER_RING - 1);
+        size_t n = h - t;
+        struct iovec iov[2] = {
+            { w->buf + off, n < WRITER_RING - off ? n : WRITER_RING - off },
+            { w->buf, 0 },
+        };
+        iov[1].iov_len = n - iov[0].iov_len;
+        ssize_t r = writev(w->fd, iov, iov[1].iov_len ? 2 : 1);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("writev");
+            exit(1);
+        }
+        w->writes++;
+        t += r;
+        atomic_store_explicit(&w->tail, t, memory_order_release);
+
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&w->producer_waiting, memory_order_relaxed))
+            signal_evt(&w->space_evt);
+    }
+    return NULL;
+}
+
+int writer_start(writer_t *w, int fd)
+{
+    memset(w, 0, sizeof(*w));
+    w->fd = fd;
+    w->buf = malloc(WRITER_RING);
+    if (!w->buf) {
+        perror("malloc");
+        return -1;
+    }
+    int err = pthread_create(&w->thread, NULL, writer_main, w);
+    if (err) {
+        errno = err;
+        perror("pthread_create");
+        free(w->buf);
+        return -1;
+    }
+    return 0;
+}
+
+void writer_commit(writer_t *w)
+{
+    atomic_store_explicit(&w->head, w->head_local, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    // 累積滿一個 block 才叫醒，不然讓 writer 自己 linger 到時間再寫
+    if (atomic_load_explicit(&w->writer_waiting, memory_order_relaxed) &&
+        atomic_load_explicit(&w->head, memory_order_relaxed) -
+        atomic_load_explicit(&w->tail, memory_order_relaxed) >= WRITER_BLOCK)
+        signal_evt(&w->data_evt);
+}
+
+void writer_put(writer_t *w, const void *buf, size_t n)
+{
+    const char *p = buf;
+    uint64_t h = w->head_local;
+
+    while (n > 0) {
+        if (h - w->tail_cache == WRITER_RING) {
+            w->tail_cache = atomic_load_explicit(&w->tail, memory_order_acquire);
+            while (h - w->tail_cache == WRITER_RING) {
+                // 滿了：先把目前的內容交出去、叫醒 writer，等它寫掉一些
+                atomic_store_explicit(&w->head, h, memory_order_release);
+                int e = atomic_load(&w->space_evt);
+                atomic_store(&w->producer_waiting, 1);
+                signal_evt(&w->data_evt);
+                w->tail_cache = atomic_load(&w->tail);
+                if (h - w->tail_cache < WRITER_RING)
+                    break;
+                wait_evt(&w->space_evt, e, 0);
+                w->tail_cache = atomic_load_explicit(&w->tail, memory_order_acquire);
+            }
+            atomic_store_explicit(&w->producer_waiting, 0, memory_order_relaxed);
+        }
+
+        size_t off = h & (WRITER_RING - 1);
+        size_t chunk = WRITER_RING - (h - w->tail_cache);     // free space
+        if (chunk > WRITER_RING - off)
+            chunk = WRITER_RING - off;                         // up to the end of the ring
+        if (chunk > n)
+            chunk = n;
+        memcpy(w->buf + off, p, chunk);
+        h += chunk;
+        p += chunk;
+        n -= chunk;
+    }
+    w->head_local = h;
+}
+
+void writer_stop(writer_t *w)
+{
+    writer_commit(w);
+    atomic_store_explicit(&w->done, 1, memory_order_release);
+    signal_evt(&w->data_evt);
+    pthread_join(w->thread, NULL);
+    free(w->buf);
+}
@@ -0,0 +1,49 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "ring.h"       // CACHE_LINE
+
+#define WRITER_RING    (1 << 22)   // 4 MB byte ring, must be a power of two
+#define WRITER_BLOCK   (1 << 16)   // wake the writer once this much is pending
+#define WRITER_LINGER  10          // ms: otherwise the writer flushes on its own this often
+
+/*
+ * Output stage of the receiver: the receive loop appends bytes to a
+ * single-producer / single-consumer byte ring and a separate thread drains
+ * it to `fd` with writev() (two iovecs when the data wraps around). The
+ * producer only enters the kernel to wake the writer when a whole block is
+ * pending or when the ring is full; a sleeping writer also wakes up every
+ * WRITER_LINGER ms so a slow trickle of lines still reaches the terminal.
+ */
+typedef struct {
+    int fd;
+    char *buf;
+    pthread_t thread;
+
+    _Alignas(CACHE_LINE) _Atomic uint64_t head;   // bytes committed (producer)
+    uint64_t head_local;                           // bytes appended, not yet committed
+    uint64_t tail_cache;
+
+    _Alignas(CACHE_LINE) _Atomic uint64_t tail;   // bytes written out (writer thread)
+
+    _Alignas(CACHE_LINE) _Atomic int writer_waiting;
+    _Atomic int producer_waiting;
+    _Atomic int data_evt, space_evt;              // futex event counters
+    _Atomic int done;
+
+    unsigned long writes;                          // writev() calls
+} writer_t;
+
+int  writer_start(writer_t *w, int fd);
+// Append n bytes; blocks only while the ring is full.
+void writer_put(writer_t *w, const void *buf, size_t n);
+// Make everything appended so far visible to the writer thread.
+void writer_commit(writer_t *w);
+// Flush the rest and join the thread.
+void writer_stop(writer_t *w);
+
+#endif
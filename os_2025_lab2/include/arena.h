@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for everything one command line needs (cmd, cmd_nodes,
+ * argv vectors, the token text). Nothing is freed one by one: the shell
+ * calls arena_reset() once per loop iteration, so after the first few
+ * lines parsing does not call malloc() at all.
+ */
+struct arena {
+	char *buf;
+	size_t cap, used;
+	size_t overflow;		// bytes that did not fit into buf since the last reset
+	struct arena_block *extra;	// blocks holding those bytes
+};
+
+void *arena_alloc(struct arena *a, size_t size);
+char *arena_strdup(struct arena *a, const char *s);
+char *arena_strndup(struct arena *a, const char *s, size_t len);
+void arena_reset(struct arena *a);
+void arena_free(struct arena *a);
+
+#endif
@@ -1,21 +1,45 @@
 #ifndef BUILTIN_H
 #define BUILTIN_H
+#include <stdio.h>
 #include "../include/command.h"
 
+// index of each builtin in builtin_str[] / builtin_func[]
+enum {
+	BI_HELP,
+	BI_CD,
+	BI_PWD,
+	BI_ECHO,
+	BI_EXIT,
+	BI_RECORD,
+	BI_HASH,
+	BI_JOBS,
+	BI_WAIT,
+	BI_FG,
+	BI_PARALLEL,
+};
 
 int searchBuiltInCommand(struct cmd_node *cmd);
-int execBuiltInCommand(int status,struct cmd_node *cmd);
+int execBuiltInCommand(int status,struct cmd_node *cmd, FILE *in, FILE *out);
 
-int pwd(char **args);
-int help(char **args);
-int cd(char **args);
-int echo(char **args);
-int exit_shell(char **args);
-int record(char **args);
+/*
+ * Builtins read from in and write to out instead of stdin / stdout,
+ * so a pipeline stage can run one in a thread on the pipe's fds.
+ */
+int pwd(char **args, FILE *in, FILE *out);
+int help(char **args, FILE *in, FILE *out);
+int cd(char **args, FILE *in, FILE *out);
+int echo(char **args, FILE *in, FILE *out);
+int exit_shell(char **args, FILE *in, FILE *out);
+int record(char **args, FILE *in, FILE *out);
+int hash(char **args, FILE *in, FILE *out);
+int jobs(char **args, FILE *in, FILE *out);
+int wait_jobs(char **args, FILE *in, FILE *out);
+int fg(char **args, FILE *in, FILE *out);
+int parallel(char **args, FILE *in, FILE *out);
 
 extern const char *builtin_str[];
 
-extern const int (*builtin_func[]) (char **);
+extern int (*const builtin_func[]) (char **, FILE *, FILE *);
 
 extern int num_builtins();
 
@@ -5,6 +5,7 @@
 #define BUF_SIZE 1024
 
 #include <stdbool.h>
+#include "arena.h"
 
 struct cmd_node {
 	char **args;
@@ -18,13 +19,36 @@ struct cmd_node {
 struct cmd {
 	struct cmd_node *head;
 	int pipe_num;
+	bool background;	// ended with &
+	const char *line;	// the line it was parsed from (not a copy, not terminated)
+	size_t line_len;
+};
+
+/*
+ * Input read in blocks with read(2) instead of stdio, so that "stdin is
+ * readable" from epoll and "a line is buffered here" never disagree.
+ * A script file is mapped instead (open_script()), and `my_shell -c`
+ * points buf at its argument: then everything is buffered and eof is set.
+ * Lines are never modified in place, so buf may be read-only.
+ */
+struct line_reader {
+	int fd;			// -1 when there is nothing left to read
+	char *buf;
+	size_t cap;
+	size_t start, end;	// unread bytes are buf[start, end)
+	bool eof;
+	bool mapped;		// buf is an mmap() of the script
 };
 
 extern char *history[MAX_RECORD_NUM];
 extern int history_count;
 
-char *read_line();
-struct cmd *split_line(char *);
+int open_script(struct line_reader *r, const char *path);
+void close_script(struct line_reader *r);
+int fill_line(struct line_reader *r);
+const char *read_line(struct line_reader *r, size_t *len);
+void record_line(const char *line, size_t len);
+struct cmd *split_line(const char *, size_t, struct arena *);
 void test_cmd_struct(struct cmd *);
 void test_pipe_struct(struct cmd_node *pipe);
 #endif
@@ -0,0 +1,37 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * Background jobs (`cmd &`) and the shell's event loop.
+ * One epoll set watches the input, a signalfd for SIGCHLD and the output pipe
+ * of every job, so the shell sleeps until one of them has something to
+ * say. A job is found from its id through an array and from its pipe
+ * through the epoll event itself. Children are reaped by process group:
+ * on SIGCHLD only the jobs on a list of those still running are waited
+ * for, so finished ones cost nothing. The foreground pipeline is waited
+ * for in the same loop, so jobs keep running meanwhile; if ^Z stops it,
+ * it becomes a job too.
+ */
+
+#define MAX_JOBS 64
+
+struct rusage;
+typedef void (*jobs_reap_fn)(void *arg, pid_t pid, int status, const struct rusage *ru);
+
+int jobs_init();
+int jobs_new(const char *text, size_t len);
+int jobs_add_stopped(const char *text, size_t len, pid_t pgid, int left, pid_t last, int status);
+void jobs_track(int id, pid_t pid);
+void jobs_start(int id, int out);
+bool jobs_poll(int timeout, int in_fd);
+void jobs_print(FILE *out);
+int jobs_parse_id(const char *arg);
+void jobs_wait(int id);
+void jobs_wait_group(pid_t pgid, int *left, jobs_reap_fn fn, void *arg);
+int jobs_fg(int id, FILE *out);
+
+#endif
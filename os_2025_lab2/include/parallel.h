@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * The engine of the parallel builtin: one command per argument, at most
+ * max_jobs of them running at once, started through spawn_proc() like
+ * any other external command. A new one starts as soon as one ends.
+ */
+
+int parallel_run(char **tmpl, int n_tmpl, char **args, FILE *in, FILE *out,
+                 int max_jobs, bool keep_order);
+
+#endif
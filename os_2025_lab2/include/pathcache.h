@@ -0,0 +1,18 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <stdio.h>
+
+/*
+ * Command name -> absolute path cache (like bash's `hash`).
+ * Filled on first use of a name, flushed whenever $PATH changes,
+ * and an entry is dropped when exec of its path fails.
+ * Safe to use from builtin threads (a mutex guards the table).
+ */
+
+const char *path_lookup(const char *name, char *buf);
+void path_forget(const char *name);
+void path_clear();
+void path_print(FILE *out);
+
+#endif
@@ -1,11 +1,21 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#include <stdbool.h>
+#include <sys/types.h>
 #include "command.h"
 
-int spawn_proc(struct cmd_node *);
+// how spawn_proc() starts external commands (my_shell -L)
+#define LAUNCH_FORK  0	// fork() + execv()
+#define LAUNCH_SPAWN 1	// posix_spawn(), i.e. clone(CLONE_VM | CLONE_VFORK)
+
+extern int launch_engine;
+extern int report_stages;	// my_shell -T: print each stage's status and times
+
+pid_t spawn_proc(struct cmd_node *, pid_t pgid, bool stoppable);
+int terminal_to(pid_t pgid);
 int fork_cmd_node(struct cmd *cmd);
 void redirection(struct cmd_node *cmd);
-void shell();
+void shell(struct line_reader *input, bool interactive);
 
 #endif
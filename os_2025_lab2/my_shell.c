@@ -1,17 +1,71 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "include/shell.h"
 #include "include/command.h"
 
 int history_count;
 char *history[MAX_RECORD_NUM];
 
+static void usage()
+{
+	fprintf(stderr, "Usage: ./my_shell [-L fork|spawn] [-T] [-c command | script]\n");
+	fprintf(stderr, "  -L ENGINE  how external commands are started (default fork)\n");
+	fprintf(stderr, "  -T         after each command, report every stage's exit status and times\n");
+	fprintf(stderr, "  -c COMMAND run COMMAND (lines separated by newlines) and exit\n");
+	fprintf(stderr, "  script     run the commands in file script, without prompt or history\n");
+}
+
 int main(int argc, char *argv[])
 {
+	int opt;
+	const char *command = NULL;
+	// '+': options stop at the script name
+	while ((opt = getopt(argc, argv, "+L:Tc:")) != -1) {
+		switch (opt) {
+		case 'L':
+			if (strcmp(optarg, "fork") == 0)
+				launch_engine = LAUNCH_FORK;
+			else if (strcmp(optarg, "spawn") == 0)
+				launch_engine = LAUNCH_SPAWN;
+			else {
+				usage();
+				return 1;
+			}
+			break;
+		case 'T':
+			report_stages = 1;
+			break;
+		case 'c':
+			command = optarg;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
 	history_count = 0;
 	for (int i = 0; i < MAX_RECORD_NUM; ++i)
     	history[i] = (char *)malloc(BUF_SIZE * sizeof(char));
 
-	shell();
+	struct line_reader input = { .fd = STDIN_FILENO };
+	if (command) {
+		// the whole input is already in memory
+		input = (struct line_reader){ .fd = -1, .buf = (char *)command, .end = strlen(command), .eof = true };
+		shell(&input, false);
+	} else if (optind < argc) {
+		if (open_script(&input, argv[optind]) < 0) {
+			perror(argv[optind]);
+			return 1;
+		}
+		shell(&input, false);
+		close_script(&input);
+	} else {
+		shell(&input, true);
+		free(input.buf);
+	}
 
 	for (int i = 0; i < MAX_RECORD_NUM; ++i)
     	free(history[i]);
@@ -0,0 +1,92 @@
+/*
+ * Commands per second through spawn_proc() for each launch engine:
+ *
+ *   ./spawn_bench [-n count] [-m 0,64,512] [command args...]
+ *
+ * Before each round the process touches -m megabytes of heap, standing in
+ * for a shell that has grown; fork() has to copy the page tables for all
+ * of it, posix_spawn() does not. The command defaults to /bin/true.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "include/shell.h"
+#include "include/command.h"
+
+#define MAX_SIZES 16
+
+int history_count;
+char *history[MAX_RECORD_NUM];
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double run(struct cmd_node *node, int engine, int count)
+{
+	launch_engine = engine;
+	double t0 = now_sec();
+	for (int i = 0; i < count; ++i) {
+		pid_t pid = spawn_proc(node, 0, true);
+		if (pid < 0)
+			exit(1);
+		if (pid > 0)
+			waitpid(pid, NULL, 0);
+	}
+	return now_sec() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+	int count = 2000, sizes[MAX_SIZES] = { 0, 64, 512 }, n_sizes = 3;
+	int opt;
+	while ((opt = getopt(argc, argv, "+n:m:")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'm':
+			n_sizes = 0;
+			for (char *tok = strtok(optarg, ","); tok && n_sizes < MAX_SIZES; tok = strtok(NULL, ","))
+				sizes[n_sizes++] = atoi(tok);
+			break;
+		default:
+			fprintf(stderr, "Usage: ./spawn_bench [-n count] [-m 0,64,512] [command args...]\n");
+			return 1;
+		}
+	}
+
+	char *true_args[] = { "/bin/true", NULL };
+	struct cmd_node node = { 0 };
+	node.args = optind < argc ? &argv[optind] : true_args;
+	node.length = optind < argc ? argc - optind : 1;
+	node.in = 0;
+	node.out = 1;
+
+	printf("%8s %8s %12s %12s\n", "heap MB", "engine", "cmds/s", "us/cmd");
+	for (int i = 0; i < n_sizes; ++i) {
+		size_t bytes = (size_t)sizes[i] << 20;
+		char *heap = bytes ? malloc(bytes) : NULL;
+		if (bytes && heap == NULL) {
+			perror("malloc");
+			return 1;
+		}
+		// touch every page so it is really mapped
+		if (heap)
+			memset(heap, 1, bytes);
+
+		for (int engine = LAUNCH_FORK; engine <= LAUNCH_SPAWN; ++engine) {
+			double sec = run(&node, engine, count);
+			printf("%8d %8s %12.0f %12.1f\n", sizes[i], engine == LAUNCH_FORK ? "fork" : "spawn",
+			       count / sec, sec / count * 1e6);
+		}
+		free(heap);
+	}
+	return 0;
+}
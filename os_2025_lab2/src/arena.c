@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include <string.h>
+#include "../include/arena.h"
+
+#define ARENA_MIN_SIZE 4096
+
+struct arena_block {
+	struct arena_block *next;
+	alignas(max_align_t) char data[];
+};
+
+static size_t align_up(size_t n)
+{
+	return (n + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size);
+	if (p == NULL) {
+		perror("Unable to allocate arena");
+		exit(1);
+	}
+	return p;
+}
+
+static void free_blocks(struct arena *a)
+{
+	while (a->extra) {
+		struct arena_block *b = a->extra;
+		a->extra = b->next;
+		free(b);
+	}
+}
+
+/**
+ * @brief Allocate size bytes, valid until the next arena_reset()
+ * 
+ * @param a Arena
+ * @param size Bytes needed
+ * @return void* 
+ * Memory aligned for any type
+ */
+void *arena_alloc(struct arena *a, size_t size)
+{
+	size = align_up(size ? size : 1);
+	if (a->buf == NULL) {
+		a->cap = ARENA_MIN_SIZE;
+		a->buf = xmalloc(a->cap);
+	}
+	if (a->used + size <= a->cap) {
+		void *p = a->buf + a->used;
+		a->used += size;
+		return p;
+	}
+
+	// buf is full: this line gets a block of its own, the next reset makes buf big enough
+	struct arena_block *b = xmalloc(sizeof(struct arena_block) + size);
+	b->next = a->extra;
+	a->extra = b;
+	a->overflow += size;
+	return b->data;
+}
+
+char *arena_strdup(struct arena *a, const char *s)
+{
+	return arena_strndup(a, s, strlen(s));
+}
+
+/**
+ * @brief Copy of the first len bytes of s, '\0' terminated
+ */
+char *arena_strndup(struct arena *a, const char *s, size_t len)
+{
+	char *d = arena_alloc(a, len + 1);
+	memcpy(d, s, len);
+	d[len] = '\0';
+	return d;
+}
+
+/**
+ * @brief Release everything allocated since the last reset
+ * If the arena overflowed, buf grows to hold all of it next time.
+ * 
+ * @param a Arena
+ */
+void arena_reset(struct arena *a)
+{
+	if (a->extra != NULL) {
+		size_t need = a->used + a->overflow;
+		free_blocks(a);
+		size_t cap = a->cap;
+		while (cap < need)
+			cap *= 2;
+		free(a->buf);
+		a->buf = xmalloc(cap);
+		a->cap = cap;
+	}
+	a->used = 0;
+	a->overflow = 0;
+}
+
+void arena_free(struct arena *a)
+{
+	free_blocks(a);
+	free(a->buf);
+	a->buf = NULL;
+	a->cap = a->used = a->overflow = 0;
+}
@@ -6,13 +6,27 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
 #include "../include/builtin.h"
+#include "../include/pathcache.h"
+#include "../include/jobs.h"
+#include "../include/parallel.h"
 
 
 
+/*
+ * Perfect hash over the builtin names: length, first and last byte pick
+ * one of 32 buckets. The values are case labels below, so two builtins
+ * landing in the same bucket is a "duplicate case value" compile error;
+ * when adding a builtin, change the multiplier until it builds.
+ */
+#define BUILTIN_HASH(len, first, last) \
+	(((unsigned)(first) + (unsigned)(last) * 15 + (unsigned)(len)) & 31)
+
 /**
  * @brief 
  * Determine whether cmd is a built-in command
+ * One switch on the hash and a single strcmp() to confirm the name.
  * @param cmd Command structure
  * @return int 
  * If command is built-in command return function number
@@ -20,36 +34,54 @@
  */
 int searchBuiltInCommand(struct cmd_node *cmd)
 {
-	for (int i = 0; i < num_builtins(); ++i){
-		if (strcmp(cmd->args[0], builtin_str[i]) == 0){
-			return i;
-		}
+	const char *name = cmd->args[0];
+	if (name == NULL || name[0] == '\0')
+		return -1;
+
+	size_t len = strlen(name);
+	int i;
+	switch (BUILTIN_HASH(len, name[0], name[len - 1])) {
+	case BUILTIN_HASH(4, 'h', 'p'): i = BI_HELP;   break;
+	case BUILTIN_HASH(2, 'c', 'd'): i = BI_CD;     break;
+	case BUILTIN_HASH(3, 'p', 'd'): i = BI_PWD;    break;
+	case BUILTIN_HASH(4, 'e', 'o'): i = BI_ECHO;   break;
+	case BUILTIN_HASH(4, 'e', 't'): i = BI_EXIT;   break;
+	case BUILTIN_HASH(6, 'r', 'd'): i = BI_RECORD; break;
+	case BUILTIN_HASH(4, 'h', 'h'): i = BI_HASH;   break;
+	case BUILTIN_HASH(4, 'j', 's'): i = BI_JOBS;   break;
+	case BUILTIN_HASH(4, 'w', 't'): i = BI_WAIT;   break;
+	case BUILTIN_HASH(2, 'f', 'g'): i = BI_FG;     break;
+	case BUILTIN_HASH(8, 'p', 'l'): i = BI_PARALLEL; break;
+	default:
+		return -1;
 	}
-	return -1;
+	return strcmp(name, builtin_str[i]) == 0 ? i : -1;
 }
 /**
  * @brief Execute built-in command
  * 
  * @param status Choose which built-in command to execute
  * @param cmd Command structure
+ * @param in Stream the builtin reads
+ * @param out Stream the builtin writes
  * @return int 
  * Return execution status
  */
-int execBuiltInCommand(int status,struct cmd_node *cmd){
-	status = (*builtin_func[status])(cmd->args);
+int execBuiltInCommand(int status,struct cmd_node *cmd, FILE *in, FILE *out){
+	status = (*builtin_func[status])(cmd->args, in, out);
 	return status;
 }
 
-int help(char **args)
+int help(char **args, FILE *in, FILE *out)
 {
 	int i;
-    printf("--------------------------------------------------\n");
-  	printf("My Little Shell!!\n");
-	printf("The following are built in:\n");
+    fprintf(out, "--------------------------------------------------\n");
+  	fprintf(out, "My Little Shell!!\n");
+	fprintf(out, "The following are built in:\n");
 	for (i = 0; i < num_builtins(); i++) {
-    	printf("%d: %s\n", i, builtin_str[i]);
+    	fprintf(out, "%d: %s\n", i, builtin_str[i]);
   	}
-    printf("--------------------------------------------------\n");
+    fprintf(out, "--------------------------------------------------\n");
 	return 1;
 }
 // ======================= requirement 2.1 =======================
@@ -60,7 +92,7 @@ int count_length_args(char **args) {
 	}
 	return count;
 }
-int cd(char **args)
+int cd(char **args, FILE *in, FILE *out)
 { // chdir
 	// args[0] == cd
 	// args[1] == the destination path
@@ -68,36 +100,36 @@ int cd(char **args)
 	int length_args = count_length_args(args);
 
 	if (length_args < 2) {
-		printf("args has length less than 2, wrong usage\n");
+		fprintf(out, "args has length less than 2, wrong usage\n");
 		return -1; // error
 	}
 	if (length_args > 2) {
-		printf("args has length larger than 2, wrong usage\n");
+		fprintf(out, "args has length larger than 2, wrong usage\n");
 		return -1; // error
 	}
 	// chdir: change directory
 	// return 0 -> success, -1 -> failure
 	int chdir_return = chdir(args[1]);
 	if (chdir_return != 0) {
-		printf("error path"); 
+		fprintf(out, "error path"); 
 		return -1;
 	}
 	return 1;
 }
 // ===============================================================
 
-int pwd(char **args)
+int pwd(char **args, FILE *in, FILE *out)
 {
 	char cwd[BUF_SIZE];
     if (getcwd(cwd, sizeof(cwd)) != NULL) {
-        printf("%s\n", cwd);
+        fprintf(out, "%s\n", cwd);
     } else {
         perror("pwd");
     }
     return 1;
 }
 
-int echo(char **args)
+int echo(char **args, FILE *in, FILE *out)
 {
 	bool newline = true;
 	for (int i = 1; args[i]; ++i) {
@@ -105,49 +137,170 @@ int echo(char **args)
 			newline = false;
 			continue;
 		}
-		printf("%s", args[i]);
+		fprintf(out, "%s", args[i]);
 		if (args[i + 1])
-			printf(" ");
+			fprintf(out, " ");
 	}
 	if (newline)
-		printf("\n");
+		fprintf(out, "\n");
 
 	return 1;
 }
 
-int exit_shell(char **args)
+int exit_shell(char **args, FILE *in, FILE *out)
 {
 	return 0;
 }
 
-int record(char **args)
+int record(char **args, FILE *in, FILE *out)
 {
 	if (history_count < MAX_RECORD_NUM) {
 		for (int i = 0; i < history_count; ++i)
-			printf("%2d: %s\n", i + 1, history[i]);
+			fprintf(out, "%2d: %s\n", i + 1, history[i]);
 	} else {
 		for (int i = history_count % MAX_RECORD_NUM; i < history_count % MAX_RECORD_NUM + MAX_RECORD_NUM; ++i)
-			printf("%2d: %s\n", i - history_count % MAX_RECORD_NUM + 1, history[i % MAX_RECORD_NUM]);
+			fprintf(out, "%2d: %s\n", i - history_count % MAX_RECORD_NUM + 1, history[i % MAX_RECORD_NUM]);
+	}
+	return 1;
+}
+
+/**
+ * @brief Show or update the PATH cache
+ * hash          list cached commands with their hit counts
+ * hash -r       forget everything
+ * hash name...  look the names up now
+ */
+int hash(char **args, FILE *in, FILE *out)
+{
+	if (args[1] == NULL) {
+		path_print(out);
+		return 1;
+	}
+	if (strcmp(args[1], "-r") == 0) {
+		path_clear();
+		return 1;
+	}
+	char buf[PATH_MAX];
+	for (int i = 1; args[i]; ++i) {
+		path_forget(args[i]);
+		if (path_lookup(args[i], buf) == NULL)
+			fprintf(out, "hash: %s: not found\n", args[i]);
+	}
+	return 1;
+}
+
+/**
+ * @brief List the background jobs
+ */
+int jobs(char **args, FILE *in, FILE *out)
+{
+	jobs_print(out);
+	return 1;
+}
+
+/**
+ * @brief Wait for background jobs
+ * wait           all of them
+ * wait %1 2...   the given ones
+ * Their output keeps coming through while waiting.
+ */
+int wait_jobs(char **args, FILE *in, FILE *out)
+{
+	if (args[1] == NULL) {
+		jobs_wait(0);
+		return 1;
+	}
+	for (int i = 1; args[i]; ++i) {
+		int id = jobs_parse_id(args[i]);
+		if (id < 0)
+			fprintf(out, "wait: %s: no such job\n", args[i]);
+		else
+			jobs_wait(id);
+	}
+	return 1;
+}
+
+/**
+ * @brief Wait for a background job (default: the last one) in the foreground
+ */
+int fg(char **args, FILE *in, FILE *out)
+{
+	int id = args[1] ? jobs_parse_id(args[1]) : 0;
+	if (id < 0 || jobs_fg(id, out) < 0)
+		fprintf(out, "fg: %s: no such job\n", args[1] ? args[1] : "current");
+	return 1;
+}
+
+/**
+ * @brief Run a command once per argument, several at a time
+ * parallel [-j N] [-k] command [words with {}] [::: arg...]
+ * Without :::, the arguments are the lines of stdin. {} in the command
+ * is replaced by the argument, with no {} it is appended.
+ * -j N  at most N commands at once (default: the number of CPUs)
+ * -k    print the outputs in argument order
+ */
+int parallel(char **args, FILE *in, FILE *out)
+{
+	int max_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	bool keep_order = false;
+	int i = 1;
+
+	for (; args[i] && args[i][0] == '-'; ++i) {
+		if (strcmp(args[i], "-k") == 0) {
+			keep_order = true;
+		} else if (strncmp(args[i], "-j", 2) == 0) {
+			const char *n = args[i][2] ? args[i] + 2 : args[++i];
+			max_jobs = n ? atoi(n) : 0;
+			if (max_jobs < 1) {
+				fprintf(out, "parallel: -j needs a positive number\n");
+				return -1;
+			}
+		} else {
+			fprintf(out, "parallel: unknown option %s\n", args[i]);
+			return -1;
+		}
+	}
+	if (max_jobs < 1)
+		max_jobs = 1;
+
+	int start = i;
+	while (args[i] && strcmp(args[i], ":::") != 0)
+		++i;
+	if (i == start) {
+		fprintf(out, "usage: parallel [-j N] [-k] command [{}...] [::: arg...]\n");
+		return -1;
 	}
+	parallel_run(&args[start], i - start, args[i] ? &args[i + 1] : NULL, in, out,
+	             max_jobs, keep_order);
 	return 1;
 }
 
 const char *builtin_str[] = {
- 	"help",
- 	"cd",
-	"pwd",
-	"echo",
- 	"exit",
- 	"record",
+ 	[BI_HELP]   = "help",
+ 	[BI_CD]     = "cd",
+	[BI_PWD]    = "pwd",
+	[BI_ECHO]   = "echo",
+ 	[BI_EXIT]   = "exit",
+ 	[BI_RECORD] = "record",
+	[BI_HASH]   = "hash",
+	[BI_JOBS]   = "jobs",
+	[BI_WAIT]   = "wait",
+	[BI_FG]     = "fg",
+	[BI_PARALLEL] = "parallel",
 };
 
-const int (*builtin_func[]) (char **) = {
-	&help,
-	&cd,
-	&pwd,
-	&echo,
-	&exit_shell,
-  	&record,
+int (*const builtin_func[]) (char **, FILE *, FILE *) = {
+	[BI_HELP]   = &help,
+	[BI_CD]     = &cd,
+	[BI_PWD]    = &pwd,
+	[BI_ECHO]   = &echo,
+	[BI_EXIT]   = &exit_shell,
+  	[BI_RECORD] = &record,
+	[BI_HASH]   = &hash,
+	[BI_JOBS]   = &jobs,
+	[BI_WAIT]   = &wait_jobs,
+	[BI_FG]     = &fg,
+	[BI_PARALLEL] = &parallel,
 };
 
 int num_builtins() {
@@ -2,87 +2,228 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../include/command.h"
 
+#define BLOCK_SIZE (64 * 1024)	// one read(2) of input
+
 /**
- * @brief Read the user's input string
+ * @brief Prepare r to run the script at path
+ * A regular file is mapped whole, so its lines are read where they lie;
+ * anything else (a FIFO, /dev/stdin) is read in BLOCK_SIZE blocks.
  * 
- * @return char* 
- * Return string
+ * @return int 
+ * 0 on success, -1 if the file cannot be opened (errno is set)
  */
-char *read_line()
+int open_script(struct line_reader *r, const char *path)
 {
-    char *buffer = (char *)malloc(BUF_SIZE * sizeof(char));
-    if (buffer == NULL) {
-        perror("Unable to allocate buffer");
-        exit(1);
-    }
+	struct stat st;
+	memset(r, 0, sizeof(*r));
+	r->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (r->fd < 0)
+		return -1;
+
+	if (fstat(r->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			close(r->fd);
+			r->fd = -1;
+			r->buf = (char *)map;
+			r->cap = r->end = st.st_size;
+			r->eof = true;
+			r->mapped = true;
+		}
+	}
+	return 0;
+}
+
+void close_script(struct line_reader *r)
+{
+	if (r->mapped)
+		munmap(r->buf, r->cap);
+	else
+		free(r->buf);
+	if (r->fd >= 0)
+		close(r->fd);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+/**
+ * @brief Read what is available on r->fd (one read(2)) into the buffer
+ * Call it when the event loop says the fd is readable; the lines
+ * returned by read_line() before are no longer valid afterwards.
+ * 
+ * @return int 
+ * Bytes read, 0 at EOF (r->eof is set), -1 on error
+ */
+int fill_line(struct line_reader *r)
+{
+	// keep only the unread part, at the front
+	if (r->start > 0) {
+		memmove(r->buf, r->buf + r->start, r->end - r->start);
+		r->end -= r->start;
+		r->start = 0;
+	}
+	// a line longer than the buffer makes it grow
+	if (r->cap - r->end < BUF_SIZE) {
+		r->cap = r->cap ? r->cap * 2 : BLOCK_SIZE;
+		r->buf = (char *)realloc(r->buf, r->cap);
+		if (r->buf == NULL) {
+			perror("Unable to allocate line buffer");
+			exit(1);
+		}
+	}
+
+	ssize_t n;
+	do {
+		n = read(r->fd, r->buf + r->end, r->cap - r->end);
+	} while (n < 0 && errno == EINTR);
+	if (n == 0)
+		r->eof = true;
+	if (n > 0)
+		r->end += n;
+	return (int)n;
+}
+
+/**
+ * @brief Next command line of the input
+ * The line can be any length, so a long argument list is not cut into
+ * several commands. Leading blanks are dropped; blank lines and comments
+ * (a '#' first, like a script's "#!" line) are skipped.
+ * 
+ * @param len Set to the length of the line
+ * @return const char* 
+ * The line inside r's buffer, not '\0' terminated (valid until the next
+ * fill_line()), NULL if no whole line is buffered (at EOF too, check r->eof)
+ */
+const char *read_line(struct line_reader *r, size_t *len)
+{
+	while (r->start < r->end) {
+		const char *line = r->buf + r->start;
+		const char *nl = (const char *)memchr(line, '\n', r->end - r->start);
+		size_t n;
+		if (nl != NULL) {
+			n = nl - line;
+			r->start += n + 1;
+		} else if (r->eof) {
+			// the last line has no '\n'
+			n = r->end - r->start;
+			r->start = r->end;
+		} else {
+			return NULL;
+		}
 
-	if (fgets(buffer, BUF_SIZE, stdin) != NULL) {
-		if (buffer[0] == '\n' || buffer[0] == ' ' || buffer[0] == '\t') {
-			free(buffer);
-			buffer = NULL;
-		} 
-		else {
-			buffer[strcspn(buffer, "\n")] = 0;
-			strncpy(history[history_count % MAX_RECORD_NUM], buffer, BUF_SIZE);
-			++history_count;
+		while (n > 0 && (*line == ' ' || *line == '\t')) {
+			++line;
+			--n;
 		}
+		if (n == 0 || *line == '#')
+			continue;
+		*len = n;
+		return line;
 	}
+	return NULL;
+}
+
+/**
+ * @brief Add a line to history (the first BUF_SIZE - 1 bytes of it)
+ */
+void record_line(const char *line, size_t len)
+{
+	if (len > BUF_SIZE - 1)
+		len = BUF_SIZE - 1;
+	memcpy(history[history_count % MAX_RECORD_NUM], line, len);
+	history[history_count % MAX_RECORD_NUM][len] = '\0';
+	++history_count;
+}
+
+#define ARGS_INITIAL 8
 
-	return buffer;
+/**
+ * @brief New empty cmd_node with room for ARGS_INITIAL arguments
+ */
+static struct cmd_node *new_node(struct arena *a)
+{
+	struct cmd_node *node = (struct cmd_node *)arena_alloc(a, sizeof(struct cmd_node));
+	node->args = (char **)arena_alloc(a, ARGS_INITIAL * sizeof(char *));
+	node->args[0] = NULL;
+	node->length   = 0;
+	node->in_file  = NULL;
+	node->out_file = NULL;
+	node->in       = 0;
+	node->out      = 1;
+	node->next     = NULL;
+	return node;
+}
+
+/**
+ * @brief Append token to node->args, doubling the vector when it is full
+ * 
+ * @param cap Current capacity of node->args, updated on growth
+ */
+static void add_arg(struct arena *a, struct cmd_node *node, char *token, int *cap)
+{
+	// keep one slot for the terminating NULL execv() needs
+	if (node->length + 1 == *cap) {
+		char **args = (char **)arena_alloc(a, 2 * *cap * sizeof(char *));
+		memcpy(args, node->args, node->length * sizeof(char *));
+		node->args = args;
+		*cap *= 2;
+	}
+	node->args[node->length++] = token;
+	node->args[node->length] = NULL;
 }
 
 /**
  * @brief Parse the user's command
+ * Everything (the cmd, its nodes, argv vectors and a copy of the line the
+ * tokens point into) lives in the arena, so the caller may reuse line
+ * right away and releases the result with arena_reset().
  * 
- * @param line User input command
+ * @param line User input command (need not be '\0' terminated)
+ * @param len Its length
+ * @param a Arena for the parsed structure
  * @return struct cmd* 
  * Return the parsed cmd structure
  */
-struct cmd *split_line(char *line)
+struct cmd *split_line(const char *line, size_t len, struct arena *a)
 {
-	int args_length = 10;
-    struct cmd *new_cmd = (struct cmd *)malloc(sizeof(struct cmd));
-    new_cmd->head = (struct cmd_node *)malloc(sizeof(struct cmd_node));
-    new_cmd->head->args = (char **)malloc(args_length * sizeof(char *));
-	for (int i = 0; i < args_length; ++i)
-		new_cmd->head->args[i] = NULL;
-    new_cmd->head->length = 0;
-    new_cmd->head->next = NULL;
+    struct cmd *new_cmd = (struct cmd *)arena_alloc(a, sizeof(struct cmd));
+    new_cmd->head = new_node(a);
 	new_cmd->pipe_num = 0;
+	new_cmd->background = false;
+	new_cmd->line = line;
+	new_cmd->line_len = len;
 
 	struct cmd_node *temp = new_cmd->head;
-	temp->in_file 	= NULL;
-	temp->out_file 	= NULL;
-	temp->in       	= 0;
-	temp->out 		= 1;
-    char *token = strtok(line, " ");
+	int cap = ARGS_INITIAL;
+	char *save;
+    char *token = strtok_r(arena_strndup(a, line, len), " ", &save);
     while (token != NULL) {
         if (token[0] == '|') {
-            struct cmd_node *new_pipe = (struct cmd_node *)malloc(sizeof(struct cmd_node));
-			new_pipe->args = (char **)malloc(args_length * sizeof(char *));
-			for (int i = 0; i < args_length; ++i)
-				new_pipe->args[i] = NULL;
-			new_pipe->length = 0;
-			new_pipe->next = NULL;
-			new_pipe->in_file  = NULL;
-    		new_pipe->out_file = NULL;
-		    new_pipe->in = 0;  
-    		new_pipe->out = 1; 
-			temp->next = new_pipe;
-			temp = new_pipe;
+			temp->next = new_node(a);
+			temp = temp->next;
+			cap = ARGS_INITIAL;
         } else if (token[0] == '<') {
-			token = strtok(NULL, " ");
+			token = strtok_r(NULL, " ", &save);
             temp->in_file = token;
         } else if (token[0] == '>') {
-			token = strtok(NULL, " ");
+			token = strtok_r(NULL, " ", &save);
             temp->out_file = token;
+        } else if (strcmp(token, "&") == 0) {
+			// only a trailing & is supported: the rest of the line is ignored
+			new_cmd->background = true;
+			break;
         } else {
-			temp->args[temp->length] = token;
-			temp->length++;
+			add_arg(a, temp, token, &cap);
         }
-        token = strtok(NULL, " ");
+        token = strtok_r(NULL, " ", &save);
 		new_cmd->pipe_num++;
 
     }
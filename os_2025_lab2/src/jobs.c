@@ -0,0 +1,502 @@
+#define _GNU_SOURCE	// memrchr
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include "../include/jobs.h"
+
+#define PARTIAL_MAX (64 * 1024)	// a longer line without '\n' is passed on in pieces
+
+// epoll_event.data.u64: one of these, or the job id + 1 for its output pipe
+#define EV_INPUT   0
+#define EV_SIGCHLD 1
+
+struct job {
+	int id;			// 0: free slot
+	pid_t pgid;
+	pid_t last;		// last stage: its status is the job's
+	int left;		// processes not reaped yet
+	int stopped;		// of these, stopped (^Z) and not resumed by fg
+	int status;
+	int out;		// read end of the job's stdout, -1 once at EOF
+	bool quiet;		// finished in the foreground: no "Done" line
+	char *text;		// the command line
+	char *partial;		// output after the last '\n' seen
+	size_t len, cap;
+	struct job *prev, *next;	// in the running list while left > 0
+};
+
+static struct job job_tab[MAX_JOBS];	// job id i lives in job_tab[i - 1]
+static int free_ids[MAX_JOBS], n_free;
+static int current;			// the job fg picks by default
+static struct job *running;		// jobs with processes left to reap
+
+// held by the event loop while it updates jobs, and by jobs_print(), which
+// a builtin thread of the foreground pipeline may run meanwhile
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the foreground pipeline, while jobs_wait_group() runs
+static pid_t fg_pgid;
+static jobs_reap_fn fg_reaped;
+static void *fg_arg;
+
+static int epfd = -1, sigfd = -1;
+static int watched_fd = -1, unpollable_fd = -1;	// the shell's input
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+static void running_add(struct job *j)
+{
+	j->prev = NULL;
+	j->next = running;
+	if (running)
+		running->prev = j;
+	running = j;
+}
+
+static void running_del(struct job *j)
+{
+	if (j->prev)
+		j->prev->next = j->next;
+	else
+		running = j->next;
+	if (j->next)
+		j->next->prev = j->prev;
+	j->prev = j->next = NULL;
+}
+
+// every process left is stopped
+static bool is_stopped(const struct job *j)
+{
+	return j->left > 0 && j->stopped >= j->left;
+}
+
+/**
+ * @brief The job went from running to stopped: it is fg's default now
+ */
+static void job_stopped(struct job *j)
+{
+	j->quiet = false;
+	current = j->id;
+	fprintf(stderr, "\n[%d]+ %-12s %s\n", j->id, "Stopped", j->text);
+}
+
+/**
+ * @brief Free the job once its processes are reaped and its output is drained
+ */
+static void job_check(struct job *j)
+{
+	if (j->left > 0 || j->out >= 0)
+		return;
+
+	if (!j->quiet) {
+		char state[64] = "Done";
+		if (WIFSIGNALED(j->status))
+			snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(j->status)));
+		else if (WEXITSTATUS(j->status))
+			snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(j->status));
+		fprintf(stderr, "[%d]  %-12s %s\n", j->id, state, j->text);
+	}
+
+	free_ids[n_free++] = j->id;
+	if (current == j->id)
+		current = 0;
+	free(j->text);
+	free(j->partial);
+	memset(j, 0, sizeof(*j));
+}
+
+/**
+ * @brief Pass on what a job wrote, whole lines only
+ * Lines of jobs running at the same time are not cut into each other.
+ */
+static void job_output(struct job *j)
+{
+	if (j->cap - j->len < 4096) {
+		j->cap = j->cap ? j->cap * 2 : 8192;
+		j->partial = (char *)realloc(j->partial, j->cap);
+		if (j->partial == NULL) {
+			perror("Unable to allocate job output");
+			exit(1);
+		}
+	}
+
+	ssize_t n = read(j->out, j->partial + j->len, j->cap - j->len);
+	if (n < 0 && errno == EINTR)
+		return;
+	if (n < 0)
+		perror("read job output");
+
+	// what the shell itself printed goes first
+	fflush(stdout);
+	if (n <= 0) {
+		// every writer is gone: the rest, even without a final '\n'
+		write_all(STDOUT_FILENO, j->partial, j->len);
+		j->len = 0;
+		epoll_ctl(epfd, EPOLL_CTL_DEL, j->out, NULL);
+		close(j->out);
+		j->out = -1;
+		job_check(j);
+		return;
+	}
+
+	j->len += n;
+	char *nl = (char *)memrchr(j->partial, '\n', j->len);
+	size_t whole = nl ? (size_t)(nl - j->partial + 1) : j->len >= PARTIAL_MAX ? j->len : 0;
+	write_all(STDOUT_FILENO, j->partial, whole);
+	memmove(j->partial, j->partial + whole, j->len - whole);
+	j->len -= whole;
+}
+
+/**
+ * @brief Reap every child of the foreground pipeline or of a job that has
+ * exited, and note those that stopped
+ * SIGCHLD is blocked and only read through the signalfd, so this runs
+ * when the event loop says so. Children are waited for by process group,
+ * never with waitpid(-1): those of a parallel builtin running in a
+ * pipeline thread are its own to reap. Only the jobs in the running list
+ * are visited, not the whole table.
+ */
+static void reap()
+{
+	struct signalfd_siginfo si;
+	// one signal may stand for several children: the queue is drained, waitpid() counts
+	while (read(sigfd, &si, sizeof(si)) == sizeof(si))
+		;
+
+	int status;
+	pid_t pid;
+	struct rusage ru;
+	while (fg_pgid && (pid = wait4(-fg_pgid, &status, WNOHANG | WUNTRACED, &ru)) > 0)
+		fg_reaped(fg_arg, pid, status, &ru);
+
+	for (struct job *j = running, *next; j; j = next) {
+		next = j->next;		// job_check() may free j
+		while (j->left > 0 && (pid = waitpid(-j->pgid, &status, WNOHANG | WUNTRACED)) > 0) {
+			if (WIFSTOPPED(status)) {
+				if (++j->stopped == j->left)
+					job_stopped(j);
+				continue;
+			}
+			if (pid == j->last)
+				j->status = status;
+			if (--j->left < j->stopped)
+				j->stopped = j->left;
+		}
+		if (j->left == 0) {
+			running_del(j);
+			job_check(j);
+		}
+	}
+}
+
+/**
+ * @brief Make fd the input watched by the event loop (-1: none)
+ */
+static void watch_input(int fd)
+{
+	if (fd == watched_fd || fd == unpollable_fd)
+		return;
+	struct epoll_event ev = { .events = EPOLLIN, .data.u64 = EV_INPUT };
+	if (watched_fd >= 0 && epoll_ctl(epfd, EPOLL_CTL_DEL, watched_fd, &ev) < 0)
+		perror("epoll_ctl input");
+	watched_fd = -1;
+	if (fd < 0)
+		return;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		// a regular file (my_shell < cmds.txt) cannot be watched, it is always readable
+		if (errno == EPERM)
+			unpollable_fd = fd;
+		else
+			perror("epoll_ctl input");
+		return;
+	}
+	watched_fd = fd;
+}
+
+/**
+ * @brief Set up the event loop: SIGCHLD is blocked and read from a signalfd
+ * Call before any thread is created so all of them keep SIGCHLD blocked.
+ * @return int 0 on success, -1 on error
+ */
+int jobs_init()
+{
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &set, NULL) < 0) {
+		perror("sigprocmask");
+		return -1;
+	}
+	sigfd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sigfd < 0) {
+		perror("signalfd");
+		return -1;
+	}
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		perror("epoll_create1");
+		return -1;
+	}
+	struct epoll_event ev = { .events = EPOLLIN, .data.u64 = EV_SIGCHLD };
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev) < 0) {
+		perror("epoll_ctl signalfd");
+		return -1;
+	}
+
+	// lowest ids are handed out first
+	for (n_free = 0; n_free < MAX_JOBS; ++n_free)
+		free_ids[n_free] = MAX_JOBS - n_free;
+	return 0;
+}
+
+/**
+ * @brief Reserve a job before starting its processes
+ * @param text Command line, shown by jobs
+ * @param len Its length
+ * @return int the job id, -1 if MAX_JOBS jobs are running
+ */
+int jobs_new(const char *text, size_t len)
+{
+	if (n_free == 0) {
+		fprintf(stderr, "too many jobs (%d)\n", MAX_JOBS);
+		return -1;
+	}
+	int id = free_ids[--n_free];
+	struct job *j = &job_tab[id - 1];
+	memset(j, 0, sizeof(*j));
+	j->id = id;
+	j->out = -1;
+	j->text = strndup(text, len);
+	current = id;
+	return id;
+}
+
+/**
+ * @brief Make a foreground pipeline stopped by ^Z a job, so fg can resume it
+ * @param pgid Its process group
+ * @param left Its processes not reaped yet, all of them stopped
+ * @param last Pid of the last stage; status is its status if it is reaped already
+ * @return int the job id, -1 if MAX_JOBS jobs are running
+ */
+int jobs_add_stopped(const char *text, size_t len, pid_t pgid, int left, pid_t last, int status)
+{
+	int id = jobs_new(text, len);
+	if (id < 0)
+		return -1;
+	struct job *j = &job_tab[id - 1];
+	j->pgid = pgid;
+	j->last = last;
+	j->status = status;
+	j->left = j->stopped = left;
+	running_add(j);
+	job_stopped(j);
+	return id;
+}
+
+/**
+ * @brief Add a started process to job id, in pipeline order
+ * The first one is the group leader, the last one gives the exit status.
+ */
+void jobs_track(int id, pid_t pid)
+{
+	struct job *j = &job_tab[id - 1];
+	if (j->pgid == 0)
+		j->pgid = pid;
+	j->last = pid;
+	if (j->left++ == 0)
+		running_add(j);
+}
+
+/**
+ * @brief All processes of job id are started; out is the read end of its
+ * stdout (-1 if it was redirected to a file)
+ */
+void jobs_start(int id, int out)
+{
+	struct job *j = &job_tab[id - 1];
+	struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)id + 1 };
+	if (out >= 0 && epoll_ctl(epfd, EPOLL_CTL_ADD, out, &ev) < 0) {
+		perror("epoll_ctl job output");
+		close(out);
+		out = -1;
+	}
+	j->out = out;
+
+	if (j->pgid)
+		fprintf(stderr, "[%d] %d\n", id, (int)j->pgid);
+	else
+		j->quiet = true;	// nothing started
+	job_check(j);
+}
+
+/**
+ * @brief One round of the event loop
+ * Sleeps until the input (if any) is readable, a child exited or a job
+ * wrote something, and handles the last two.
+ * @param timeout Milliseconds, -1 to wait as long as needed
+ * @param in_fd Return when this fd is readable, -1 for none
+ * @return bool true if in_fd is readable
+ */
+bool jobs_poll(int timeout, int in_fd)
+{
+	watch_input(in_fd);
+	bool in_ready = in_fd >= 0 && in_fd == unpollable_fd;
+	if (in_ready)
+		timeout = 0;
+
+	struct epoll_event evs[16];
+	int n = epoll_wait(epfd, evs, 16, timeout);
+	if (n < 0 && errno != EINTR)
+		perror("epoll_wait");
+
+	pthread_mutex_lock(&lock);
+	for (int i = 0; i < n; ++i) {
+		if (evs[i].data.u64 == EV_INPUT)
+			in_ready = true;
+		else if (evs[i].data.u64 == EV_SIGCHLD)
+			reap();
+		else
+			job_output(&job_tab[evs[i].data.u64 - 2]);
+	}
+	pthread_mutex_unlock(&lock);
+	return in_ready;
+}
+
+/**
+ * @brief List the jobs
+ * Like path_print(), the listing is built under the lock and written after.
+ */
+void jobs_print(FILE *out)
+{
+	char *text = NULL;
+	size_t len = 0;
+	FILE *mem = open_memstream(&text, &len);
+	if (mem == NULL) {
+		perror("open_memstream");
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	for (int i = 0; i < MAX_JOBS; ++i) {
+		struct job *j = &job_tab[i];
+		if (j->id)
+			fprintf(mem, "[%d]%c %7d  %-8s %s\n", j->id, j->id == current ? '+' : ' ',
+			        (int)j->pgid, is_stopped(j) ? "Stopped" : j->left ? "Running" : "Done",
+			        j->text);
+	}
+	pthread_mutex_unlock(&lock);
+
+	fclose(mem);
+	fwrite(text, 1, len, out);
+	free(text);
+}
+
+/**
+ * @brief Job id from "%3" or "3"
+ * @return int the id, -1 if there is no such job
+ */
+int jobs_parse_id(const char *arg)
+{
+	char *end;
+	if (arg[0] == '%')
+		arg++;
+	long id = strtol(arg, &end, 10);
+	if (end == arg || *end != '\0' || id < 1 || id > MAX_JOBS || job_tab[id - 1].id == 0)
+		return -1;
+	return (int)id;
+}
+
+// job id, or any job if id is 0, is still there and not stopped
+static bool busy(int id)
+{
+	for (int i = id ? id - 1 : 0; i < (id ? id : MAX_JOBS); ++i)
+		if (job_tab[i].id && !is_stopped(&job_tab[i]))
+			return true;
+	return false;
+}
+
+/**
+ * @brief Run the event loop (without the input) until job id, or every job if
+ * id is 0, has finished or stopped
+ */
+void jobs_wait(int id)
+{
+	while (busy(id))
+		jobs_poll(-1, -1);
+}
+
+/**
+ * @brief Run the event loop (without the input) until *left, which fn
+ * counts down, reaches 0
+ * fn is called for every process of group pgid that is reaped or stops
+ * (WIFSTOPPED), with its status and rusage, while the jobs' output keeps
+ * being passed on.
+ */
+void jobs_wait_group(pid_t pgid, int *left, jobs_reap_fn fn, void *arg)
+{
+	fg_pgid = pgid;
+	fg_reaped = fn;
+	fg_arg = arg;
+	// a stage may be gone already: its SIGCHLD is pending, but don't count on it
+	pthread_mutex_lock(&lock);
+	reap();
+	pthread_mutex_unlock(&lock);
+	while (*left > 0)
+		jobs_poll(-1, -1);
+	fg_pgid = 0;
+}
+
+/**
+ * @brief Resume job id (0: the current one) in the foreground
+ * The terminal goes to its process group, so ^C and ^Z reach it; a job
+ * started with & keeps /dev/null as stdin and its output still comes
+ * through the shell. Returns when it has finished or stopped again.
+ * @param out Where its command line is echoed
+ * @return int 0, or -1 if there is no such job
+ */
+int jobs_fg(int id, FILE *out)
+{
+	if (id == 0)
+		id = current;
+	for (int i = MAX_JOBS; id == 0 && i > 0; --i)
+		if (job_tab[i - 1].id)
+			id = i;
+	if (id == 0)
+		return -1;
+
+	struct job *j = &job_tab[id - 1];
+	j->quiet = true;
+	fprintf(out, "%s\n", j->text);
+	fflush(out);
+
+	int own = isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp() &&
+	          tcsetpgrp(STDIN_FILENO, j->pgid) == 0;
+	j->stopped = 0;
+	if (j->pgid)
+		kill(-j->pgid, SIGCONT);
+	jobs_wait(id);
+	if (own)
+		tcsetpgrp(STDIN_FILENO, getpgrp());
+	return 0;
+}
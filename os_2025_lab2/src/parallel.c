@@ -0,0 +1,318 @@
+#define _GNU_SOURCE	// pipe2, memrchr
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../include/parallel.h"
+#include "../include/shell.h"
+
+#define PARTIAL_MAX (64 * 1024)	// a longer line without '\n' is passed on in pieces
+
+struct par_job {
+	pid_t pid;		// 0: nothing was started
+	int fd;			// read end of its stdout, -1 once at EOF
+	int status;
+	char *buf;		// output not passed on yet
+	size_t len, cap;
+	struct par_job *next;	// in start order, while waiting to be printed (keep_order)
+};
+
+/**
+ * @brief word with every "{}" replaced by arg
+ */
+static char *expand(const char *word, const char *arg)
+{
+	size_t n = 0, arg_len = strlen(arg);
+	for (const char *p = strstr(word, "{}"); p; p = strstr(p + 2, "{}"))
+		n++;
+
+	char *s = (char *)malloc(strlen(word) + n * arg_len + 1), *d = s;
+	if (s == NULL)
+		return NULL;
+	for (const char *p; (p = strstr(word, "{}")) != NULL; word = p + 2) {
+		memcpy(d, word, p - word);
+		d += p - word;
+		memcpy(d, arg, arg_len);
+		d += arg_len;
+	}
+	strcpy(d, word);
+	return s;
+}
+
+static void free_argv(char **argv)
+{
+	for (int i = 0; argv[i]; ++i)
+		free(argv[i]);
+	free(argv);
+}
+
+/**
+ * @brief argv of the command for one argument: the template with {}
+ * replaced, or with the argument appended if it has no {}
+ */
+static char **build_argv(char **tmpl, int n_tmpl, const char *arg, int *argc)
+{
+	char **argv = (char **)calloc(n_tmpl + 2, sizeof(char *));
+	if (argv == NULL)
+		return NULL;
+	bool used = false;
+	for (*argc = 0; *argc < n_tmpl; ++*argc) {
+		used |= strstr(tmpl[*argc], "{}") != NULL;
+		argv[*argc] = expand(tmpl[*argc], arg);
+	}
+	if (!used)
+		argv[(*argc)++] = strdup(arg);
+	for (int i = 0; i < *argc; ++i) {
+		if (argv[i] == NULL) {
+			free_argv(argv);
+			return NULL;
+		}
+	}
+	return argv;
+}
+
+/**
+ * @brief Next argument: from the list, or the next line of in
+ * @return const char* NULL when there are no more
+ */
+static const char *next_arg(char ***list, FILE *in, char **line, size_t *cap)
+{
+	if (*list)
+		return **list ? *(*list)++ : NULL;
+
+	ssize_t n = getline(line, cap, in);
+	if (n < 0)
+		return NULL;
+	if (n > 0 && (*line)[n - 1] == '\n')
+		(*line)[n - 1] = '\0';
+	return *line;
+}
+
+/**
+ * @brief Start the command for arg, its stdout going into a new pipe
+ * @param pgid Process group of the jobs; 0 to lead a new one, set to it
+ * @return struct par_job* NULL on error (reported)
+ */
+static struct par_job *start_job(char **tmpl, int n_tmpl, const char *arg, int devnull,
+                                 pid_t *pgid)
+{
+	struct par_job *j = (struct par_job *)calloc(1, sizeof(struct par_job));
+	int argc, p[2];
+	char **argv = build_argv(tmpl, n_tmpl, arg, &argc);
+	if (j == NULL || argv == NULL) {
+		perror("parallel");
+		free(j);
+		if (argv)
+			free_argv(argv);
+		return NULL;
+	}
+	// close-on-exec: the other jobs must not keep this write end open
+	if (pipe2(p, O_CLOEXEC) < 0) {
+		perror("pipe error!");
+		free(j);
+		free_argv(argv);
+		return NULL;
+	}
+
+	// stdin is /dev/null: it may be where the arguments come from
+	struct cmd_node node = { .args = argv, .length = argc, .in = devnull, .out = p[1] };
+	// ^Z would stop them but not parallel itself, which runs in the shell
+	j->pid = spawn_proc(&node, *pgid, false);
+	close(p[1]);
+	free_argv(argv);
+	if (j->pid < 0) {
+		close(p[0]);
+		free(j);
+		return NULL;
+	}
+	// not started (not found): its pipe is at EOF already
+	if (j->pid == 0)
+		j->status = W_EXITCODE(127, 0);
+	else if (*pgid == 0)
+		*pgid = j->pid;
+	j->fd = p[0];
+	return j;
+}
+
+/**
+ * @brief Read what job j wrote; unless keep_order, pass on the whole lines
+ * @return int bytes read, 0 at EOF
+ */
+static int job_read(struct par_job *j, bool keep_order, FILE *out)
+{
+	if (j->cap - j->len < 4096) {
+		j->cap = j->cap ? j->cap * 2 : 8192;
+		j->buf = (char *)realloc(j->buf, j->cap);
+		if (j->buf == NULL) {
+			perror("Unable to allocate job output");
+			exit(1);
+		}
+	}
+
+	ssize_t n = read(j->fd, j->buf + j->len, j->cap - j->len);
+	if (n < 0 && errno == EINTR)
+		return 1;
+	if (n < 0)
+		perror("read job output");
+	if (n <= 0)
+		return 0;
+
+	j->len += n;
+	if (!keep_order) {
+		char *nl = (char *)memrchr(j->buf, '\n', j->len);
+		size_t whole = nl ? (size_t)(nl - j->buf + 1) : j->len >= PARTIAL_MAX ? j->len : 0;
+		fwrite(j->buf, 1, whole, out);
+		memmove(j->buf, j->buf + whole, j->len - whole);
+		j->len -= whole;
+	}
+	return (int)n;
+}
+
+/**
+ * @brief Run tmpl once per argument, at most max_jobs at a time
+ * The slots are refilled as soon as a job's output ends and it is reaped,
+ * so only finished jobs are waited for (waitpid() on their pid: the shell's
+ * other children are not touched). The jobs share one process group,
+ * which gets the terminal when the shell has it, so ^C stops them and
+ * not the shell (^Z is ignored: the shell cannot be stopped with them);
+ * a new group is started whenever the last one is empty.
+ *
+ * @param tmpl Command words, "{}" stands for the argument
+ * @param args NULL-terminated arguments, or NULL to read them from in, one per line
+ * @param keep_order Print each job's output whole and in argument order
+ * (kept in memory until the jobs before it are printed); otherwise whole
+ * lines are printed as they come
+ * @return int number of jobs that failed
+ */
+int parallel_run(char **tmpl, int n_tmpl, char **args, FILE *in, FILE *out,
+                 int max_jobs, bool keep_order)
+{
+	struct par_job **running = (struct par_job **)calloc(max_jobs, sizeof(struct par_job *));
+	struct pollfd *pfd = (struct pollfd *)calloc(max_jobs, sizeof(struct pollfd));
+	int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (running == NULL || pfd == NULL || devnull < 0) {
+		perror("parallel");
+		free(running);
+		free(pfd);
+		if (devnull >= 0)
+			close(devnull);
+		return 1;
+	}
+
+	struct par_job *head = NULL, **tail = &head;	// started, not printed yet (keep_order)
+	int n_running = 0, failed = 0, total = 0;
+	int alive = 0, own_terminal = 0;	// processes in pgid not reaped yet
+	pid_t pgid = 0;
+	bool more = true;
+	char *line = NULL;
+	size_t line_cap = 0;
+
+	// what was printed before the jobs' output goes first
+	fflush(out);
+	for (;;) {
+		// keep every slot busy
+		while (more && n_running < max_jobs) {
+			const char *arg = next_arg(&args, in, &line, &line_cap);
+			if (arg == NULL) {
+				more = false;
+				break;
+			}
+			total++;
+			struct par_job *j = start_job(tmpl, n_tmpl, arg, devnull, &pgid);
+			if (j == NULL) {
+				failed++;
+				continue;
+			}
+			if (j->pid > 0 && alive++ == 0)
+				own_terminal = terminal_to(pgid);
+			running[n_running++] = j;
+			if (keep_order) {
+				*tail = j;
+				tail = &j->next;
+			}
+		}
+		if (n_running == 0)
+			break;
+
+		for (int i = 0; i < n_running; ++i)
+			pfd[i] = (struct pollfd){ .fd = running[i]->fd, .events = POLLIN };
+		if (poll(pfd, n_running, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+
+		// backwards: a finished job's slot is refilled from the end
+		for (int i = n_running - 1; i >= 0; --i) {
+			struct par_job *j = running[i];
+			if (pfd[i].revents == 0 || job_read(j, keep_order, out) > 0)
+				continue;
+
+			// EOF: its output is complete
+			close(j->fd);
+			j->fd = -1;
+			if (j->pid > 0 && waitpid(j->pid, &j->status, 0) < 0)
+				perror("waitpid");
+			// the group is gone with its last process: take the terminal back
+			if (j->pid > 0 && --alive == 0) {
+				if (own_terminal)
+					tcsetpgrp(STDIN_FILENO, getpgrp());
+				own_terminal = 0;
+				pgid = 0;
+			}
+			if (!WIFEXITED(j->status) || WEXITSTATUS(j->status) != 0)
+				failed++;
+			// ^C: the user wants it all stopped, start nothing new
+			if (WIFSIGNALED(j->status) && WTERMSIG(j->status) == SIGINT)
+				more = false;
+			running[i] = running[--n_running];
+			if (!keep_order) {
+				fwrite(j->buf, 1, j->len, out);
+				free(j->buf);
+				free(j);
+			}
+		}
+
+		// print the finished jobs at the front of the order
+		while (keep_order && head != NULL && head->fd < 0) {
+			struct par_job *j = head;
+			fwrite(j->buf, 1, j->len, out);
+			head = j->next;
+			free(j->buf);
+			free(j);
+		}
+		if (head == NULL)
+			tail = &head;
+		fflush(out);
+	}
+
+	// only after an error: jobs still running or not printed
+	if (own_terminal)
+		tcsetpgrp(STDIN_FILENO, getpgrp());
+	for (int i = 0; !keep_order && i < n_running; ++i) {
+		close(running[i]->fd);
+		free(running[i]->buf);
+		free(running[i]);
+	}
+	while (head != NULL) {
+		struct par_job *j = head;
+		head = j->next;
+		if (j->fd >= 0)
+			close(j->fd);
+		free(j->buf);
+		free(j);
+	}
+	free(line);
+	free(running);
+	free(pfd);
+	close(devnull);
+	if (failed)
+		fprintf(stderr, "parallel: %d of %d jobs failed\n", failed, total);
+	return failed;
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../include/pathcache.h"
+
+struct path_entry {
+	char *name;		// NULL: empty slot
+	char *path;
+	unsigned long hits;
+};
+
+static struct path_entry *table;
+static size_t table_cap, table_used;
+static char *cached_path;	// $PATH the table was filled with
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hash_name(const char *s)
+{
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	while (*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * @brief Slot holding name, or the empty slot where it would go
+ */
+static struct path_entry *find_slot(const char *name)
+{
+	size_t mask = table_cap - 1;
+	for (size_t i = hash_name(name) & mask;; i = (i + 1) & mask) {
+		if (table[i].name == NULL || strcmp(table[i].name, name) == 0)
+			return &table[i];
+	}
+}
+
+static void grow()
+{
+	struct path_entry *old = table;
+	size_t old_cap = table_cap;
+
+	table_cap = old_cap ? old_cap * 2 : 64;
+	table = (struct path_entry *)calloc(table_cap, sizeof(struct path_entry));
+	if (table == NULL) {
+		perror("Unable to allocate hash table");
+		exit(1);
+	}
+	for (size_t i = 0; i < old_cap; ++i)
+		if (old[i].name)
+			*find_slot(old[i].name) = old[i];
+	free(old);
+}
+
+static void clear_table()
+{
+	for (size_t i = 0; i < table_cap; ++i) {
+		free(table[i].name);
+		free(table[i].path);
+		table[i].name = table[i].path = NULL;
+	}
+	table_used = 0;
+}
+
+static int is_executable(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+/**
+ * @brief Empty the table if $PATH is not the one it was filled with
+ */
+static void check_path_env()
+{
+	const char *env = getenv("PATH");
+	if (env == NULL)
+		env = "";
+	if (cached_path && strcmp(cached_path, env) == 0)
+		return;
+	clear_table();
+	free(cached_path);
+	cached_path = strdup(env);
+}
+
+/**
+ * @brief Same search as execvp(): the first executable regular file in $PATH
+ *
+ * @param name Command name without '/'
+ * @param buf PATH_MAX bytes for the result
+ * @param absolute Set to 1 if the directory was absolute (safe to cache across cd)
+ * @return int 1 if found, 0 otherwise
+ */
+static int search_path(const char *name, char *buf, int *absolute)
+{
+	const char *dir = cached_path;
+	for (;;) {
+		const char *end = strchr(dir, ':');
+		size_t len = end ? (size_t)(end - dir) : strlen(dir);
+		// an empty entry means the current directory
+		int n = len ? snprintf(buf, PATH_MAX, "%.*s/%s", (int)len, dir, name)
+		            : snprintf(buf, PATH_MAX, "./%s", name);
+		if (n > 0 && n < PATH_MAX && is_executable(buf)) {
+			*absolute = len && dir[0] == '/';
+			return 1;
+		}
+		if (end == NULL)
+			return 0;
+		dir = end + 1;
+	}
+}
+
+/**
+ * @brief Resolve a command name to the path to execv()
+ *
+ * @param name args[0] of the command
+ * @param buf PATH_MAX bytes the path is copied into
+ * @return const char*
+ * name itself if it contains a '/', else buf, or NULL if the command is not found
+ */
+const char *path_lookup(const char *name, char *buf)
+{
+	if (name == NULL)
+		return NULL;
+	// "./a.out", "/bin/ls": no search, just like execvp()
+	if (strchr(name, '/'))
+		return name;
+
+	pthread_mutex_lock(&lock);
+	check_path_env();
+	if (table_cap) {
+		struct path_entry *e = find_slot(name);
+		if (e->name) {
+			e->hits++;
+			strcpy(buf, e->path);
+			pthread_mutex_unlock(&lock);
+			return buf;
+		}
+	}
+
+	int absolute;
+	int found = search_path(name, buf, &absolute);
+	// relative $PATH entries ("." or "") change meaning after cd, don't keep them
+	if (found && absolute) {
+		if ((table_used + 1) * 4 > table_cap * 3)
+			grow();
+		struct path_entry *e = find_slot(name);
+		e->name = strdup(name);
+		e->path = strdup(buf);
+		e->hits = 1;
+		table_used++;
+	}
+	pthread_mutex_unlock(&lock);
+	return found ? buf : NULL;
+}
+
+/**
+ * @brief Drop name from the cache (its exec failed; search $PATH again next time)
+ */
+void path_forget(const char *name)
+{
+	pthread_mutex_lock(&lock);
+	struct path_entry *e = table_cap ? find_slot(name) : NULL;
+	if (e == NULL || e->name == NULL) {
+		pthread_mutex_unlock(&lock);
+		return;
+	}
+	free(e->name);
+	free(e->path);
+	e->name = e->path = NULL;
+	table_used--;
+
+	// linear probing: re-insert the rest of the cluster so lookups don't stop early
+	size_t mask = table_cap - 1;
+	for (size_t i = (size_t)(e - table + 1) & mask; table[i].name; i = (i + 1) & mask) {
+		struct path_entry moved = table[i];
+		table[i].name = NULL;
+		*find_slot(moved.name) = moved;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void path_clear()
+{
+	pthread_mutex_lock(&lock);
+	clear_table();
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief List the cache with hit counts
+ * The listing is built in memory under the lock and written after it is
+ * released: out may be a pipe whose reader the main thread is still starting.
+ */
+void path_print(FILE *out)
+{
+	char *text = NULL;
+	size_t len = 0;
+	FILE *mem = open_memstream(&text, &len);
+	if (mem == NULL) {
+		perror("open_memstream");
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	if (table_used == 0)
+		fprintf(mem, "hash: hash table empty\n");
+	else {
+		fprintf(mem, "hits\tcommand\n");
+		for (size_t i = 0; i < table_cap; ++i)
+			if (table[i].name)
+				fprintf(mem, "%4lu\t%s\n", table[i].hits, table[i].path);
+	}
+	pthread_mutex_unlock(&lock);
+
+	fclose(mem);
+	fwrite(text, 1, len, out);
+	free(text);
+}
@@ -1,13 +1,29 @@
+#define _GNU_SOURCE	// pipe2, fopen "e", RUSAGE_THREAD
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <spawn.h>
 #include <fcntl.h>
 #include "../include/command.h"
 #include "../include/builtin.h"
+#include "../include/shell.h"
+#include "../include/pathcache.h"
+#include "../include/jobs.h"
+
+extern char **environ;
+
+int launch_engine = LAUNCH_FORK;
+int report_stages = 0;
 
 // ======================= requirement 2.3 =======================
 /**
@@ -72,59 +88,405 @@ void redirection(struct cmd_node *p){
 }
 // ===============================================================
 
-// ======================= requirement 2.2 =======================
 /**
- * @brief 
- * Execute external command
- * The external command is mainly divided into the following two steps:
- * 1. Call "fork()" to create child process
- * 2. Call "execvp()" to execute the corresponding executable file
- * @param p cmd_node structure
- * @return int 
- * Return execution status
+ * @brief fork() engine: the child redirects and calls execv()
+ * A close-on-exec pipe tells the parent whether execv() failed,
+ * in which case the cached path is dropped.
+ * Both sides call setpgid() so the group exists whichever runs first.
+ * @return pid_t pid of the child, -1 on error
  */
-int spawn_proc(struct cmd_node *p)
+static pid_t spawn_fork(struct cmd_node *p, const char *path, pid_t pgid, bool stoppable)
 {
+	int err_pipe[2];
+	if (pipe2(err_pipe, O_CLOEXEC) < 0) {
+		perror("pipe error!");
+		return -1;
+	}
+
     pid_t pid = fork();
     if (pid < 0) {
         perror("fork failed!");
+		close(err_pipe[0]);
+		close(err_pipe[1]);
         return -1;
     } else if (pid == 0) {
+		close(err_pipe[0]);
+		setpgid(0, pgid);
+		// the shell ignores SIGTTOU and blocks SIGCHLD (see shell()), the command must not
+		sigset_t none;
+		sigemptyset(&none);
+		sigprocmask(SIG_SETMASK, &none, NULL);
+		signal(SIGTTOU, SIG_DFL);
+		if (stoppable)
+			signal(SIGTSTP, SIG_DFL);
 		// the external command should have modified stdin/stdout/stderr
 		// for example: ls > out.txt
         redirection(p);
-        execvp(p->args[0], p->args);
-        perror("execvp() failed!");
+		if (path == NULL) {
+			fprintf(stderr, "%s: command not found\n", p->args[0]);
+			exit(127);
+		}
+        execv(path, p->args);
+		// only reached if execv() failed: hand errno to the parent
+		int err = errno;
+		write(err_pipe[1], &err, sizeof(err));
+        perror("execv() failed!");
         exit(EXIT_FAILURE);
-    } else {
-        // Only wait if this command does not send output into a pipe
-		// If this command is sending output to a pipe, 
-		// p->out will be set to the write end of that pipe (some fd > 1).
-		// example: ls | grep txt
-		// Let both run at the same time or else it'll be Serializing the pipeline
-        if (p->out == 1) {
-			// go straight to the terminal
-            int status;
-            if (wait(&status) < 0) {
-                perror("wait error!");
-                return -1;
-            }
-        }
-		// If this is a normal command (no pipe)  wait() now.
-		// If this command is part of a pipe  dont wait() here; 
-		// it will be handled as part of the whole pipeline.
     }
-    return 1;
+
+	setpgid(pid, pgid ? pgid : pid);
+	// EOF: the child exec'd (or exited) and the pipe was closed
+	int err;
+	close(err_pipe[1]);
+	if (read(err_pipe[0], &err, sizeof(err)) == sizeof(err))
+		path_forget(p->args[0]);
+	close(err_pipe[0]);
+	return pid;
+}
+
+/**
+ * @brief posix_spawn() engine
+ * glibc starts the child with clone(CLONE_VM | CLONE_VFORK): no page tables
+ * are copied, so the cost does not grow with the shell's memory. The file
+ * actions do what redirection() does, in the same order (files first,
+ * then the pipe ends override them); the attributes set the process
+ * group, SIGTTOU (and SIGTSTP if stoppable) back to default and an
+ * empty signal mask.
+ * @return pid_t pid of the child, 0 if nothing was started, -1 on error
+ */
+static pid_t spawn_posix(struct cmd_node *p, const char *path, pid_t pgid, bool stoppable)
+{
+	if (path == NULL) {
+		fprintf(stderr, "%s: command not found\n", p->args[0]);
+		return 0;
+	}
+
+	posix_spawn_file_actions_t fa;
+	posix_spawn_file_actions_init(&fa);
+	if (p->in_file != NULL)
+		posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, p->in_file, O_RDONLY, 0);
+	if (p->out_file != NULL)
+		posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, p->out_file, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (p->in != 0 && p->in != -1) {
+		posix_spawn_file_actions_adddup2(&fa, p->in, STDIN_FILENO);
+		posix_spawn_file_actions_addclose(&fa, p->in);
+	}
+	if (p->out != 1 && p->out != -1) {
+		posix_spawn_file_actions_adddup2(&fa, p->out, STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&fa, p->out);
+	}
+
+	posix_spawnattr_t attr;
+	sigset_t dfl;
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+	posix_spawnattr_setpgroup(&attr, pgid);
+	sigemptyset(&dfl);
+	posix_spawnattr_setsigmask(&attr, &dfl);
+	sigaddset(&dfl, SIGTTOU);
+	if (stoppable)
+		sigaddset(&dfl, SIGTSTP);
+	posix_spawnattr_setsigdefault(&attr, &dfl);
+
+	pid_t pid;
+	// the error covers the file actions as well as execve() itself
+	int err = posix_spawn(&pid, path, &fa, &attr, p->args, environ);
+	posix_spawn_file_actions_destroy(&fa);
+	posix_spawnattr_destroy(&attr);
+	if (err != 0) {
+		fprintf(stderr, "%s: %s\n", p->args[0], strerror(err));
+		path_forget(p->args[0]);
+		return 0;
+	}
+	return pid;
+}
+
+// ======================= requirement 2.2 =======================
+/**
+ * @brief 
+ * Start external command
+ * The external command is mainly divided into the following steps:
+ * 1. Resolve args[0] through the PATH cache (in the parent, so the result is kept)
+ * 2. Start it with the engine chosen at startup (my_shell -L):
+ *    fork + redirection() + execv(), or posix_spawn() with file actions
+ * It is not waited for here: fork_cmd_node() reaps every stage of the pipeline.
+ * @param p cmd_node structure
+ * @param pgid Process group to join, 0 to lead a new one
+ * @param stoppable ^Z stops it; otherwise SIGTSTP stays ignored as in
+ * the shell (on a terminal), for commands the shell cannot stop with
+ * @return pid_t 
+ * pid of the command, 0 if nothing was started, -1 on error
+ */
+pid_t spawn_proc(struct cmd_node *p, pid_t pgid, bool stoppable)
+{
+	char buf[PATH_MAX];
+	const char *path = path_lookup(p->args[0], buf);
+	// our pending output goes first; a fork child that exits without exec would also repeat it
+	fflush(stdout);
+	return launch_engine == LAUNCH_SPAWN ? spawn_posix(p, path, pgid, stoppable)
+	                                       : spawn_fork(p, path, pgid, stoppable);
 }
 
 // ===============================================================
 
 
+/*
+ * One entry per pipeline stage: what fork_cmd_node() started and,
+ * once reaped, how it ended and what it cost.
+ *
+ * A builtin inside a pipeline runs in a thread of the shell instead of a
+ * forked child. The thread owns the stage's pipe ends (through in / out)
+ * and closes them when the builtin returns, which is the EOF the next
+ * stage waits for. Every pipe is close-on-exec so commands started while
+ * the thread runs do not hold a copy of its write end.
+ */
+struct stage {
+	struct cmd_node *node;
+	int func;		// builtin number, -1 for an external command
+	pid_t pid;		// 0: no process to reap
+	int thread;		// tid is running a builtin
+	int done;
+	int stopped;		// by ^Z, not reaped
+	int status;		// as from waitpid()
+	struct timespec start, end;
+	struct rusage ru;	// the child's, or the builtin thread's
+	FILE *in, *out;
+	pthread_t tid;
+};
+
+static void *run_builtin(void *arg)
+{
+	struct stage *s = (struct stage *)arg;
+	int ret = 1;
+
+	// a reader that went away gives EPIPE here instead of killing the shell
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	// like a subshell: cd and exit must not change the shell itself,
+	// and it has no jobs to wait for
+	if (s->func != BI_CD && s->func != BI_EXIT && s->func != BI_WAIT && s->func != BI_FG)
+		ret = execBuiltInCommand(s->func, s->node, s->in, s->out);
+
+	if (s->in != stdin)
+		fclose(s->in);
+	fclose(s->out);
+
+	getrusage(RUSAGE_THREAD, &s->ru);
+	clock_gettime(CLOCK_MONOTONIC, &s->end);
+	s->status = W_EXITCODE(ret < 0 ? 1 : 0, 0);
+	return NULL;
+}
+
+/**
+ * @brief Open the streams of a builtin stage, same precedence as
+ * redirection(): the file first, then a pipe end overrides it
+ * Takes ownership of p->in / p->out (they are closed on failure too).
+ * @return FILE* the stream, or NULL after reporting the error
+ */
+static FILE *stage_stream(struct cmd_node *p, int out)
+{
+	const char *file = out ? p->out_file : p->in_file;
+	int fd = out ? p->out : p->in;
+	int piped = out ? fd != 1 : fd != 0;
+	FILE *f = NULL;
+
+	if (file != NULL) {
+		f = fopen(file, out ? "we" : "re");
+		if (f == NULL) {
+			perror(out ? "open output file failed!" : "open input file failed!");
+			if (piped)
+				close(fd);
+			return NULL;
+		}
+		if (!piped)
+			return f;
+		fclose(f);
+	}
+	if (piped) {
+		f = fdopen(fd, out ? "w" : "r");
+		if (f == NULL) {
+			perror("fdopen");
+			close(fd);
+		}
+		return f;
+	}
+	if (!out)
+		return stdin;
+	// our own copy of the terminal, the thread closes it
+	fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+	f = fd < 0 ? NULL : fdopen(fd, "w");
+	if (f == NULL) {
+		perror("dup stdout");
+		if (fd >= 0)
+			close(fd);
+	}
+	return f;
+}
+
+/**
+ * @brief Start the builtin of stage s in a thread
+ * Its fds are closed whether or not the thread starts.
+ * @return int 1 if the thread is running, 0 if not
+ */
+static int start_builtin(struct stage *s)
+{
+	s->in = stage_stream(s->node, 0);
+	s->out = stage_stream(s->node, 1);
+
+	if (s->in != NULL && s->out != NULL) {
+		int err = pthread_create(&s->tid, NULL, run_builtin, s);
+		if (err == 0)
+			return s->thread = 1;
+		fprintf(stderr, "%s: %s\n", s->node->args[0], strerror(err));
+	}
+	if (s->in != NULL && s->in != stdin)
+		fclose(s->in);
+	if (s->out != NULL)
+		fclose(s->out);
+	return 0;
+}
+
+/**
+ * @brief A builtin in a background job runs in a forked subshell instead:
+ * the job is then only processes, reaped like the others
+ * @return pid_t pid of the child, -1 on error
+ */
+static pid_t fork_builtin(struct stage *s, pid_t pgid)
+{
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork failed!");
+		return -1;
+	} else if (pid == 0) {
+		setpgid(0, pgid);
+		redirection(s->node);
+		int ret = 1;
+		if (s->func != BI_WAIT && s->func != BI_FG)
+			ret = execBuiltInCommand(s->func, s->node, stdin, stdout);
+		fflush(stdout);
+		_exit(ret < 0 ? 1 : 0);
+	}
+	setpgid(pid, pgid ? pgid : pid);
+	return pid;
+}
+
+static double seconds(struct timeval tv)
+{
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * @brief Print how each stage ended and its real / user / sys time
+ * (my_shell -T), on stderr so it stays out of the pipeline's output
+ */
+static void report_pipeline(struct stage *stages, int n)
+{
+	fprintf(stderr, "%-3s %7s %-10s %9s %9s %9s  %s\n",
+	        "#", "pid", "status", "real", "user", "sys", "command");
+	for (int i = 0; i < n; ++i) {
+		struct stage *s = &stages[i];
+		char pid[16] = "-", status[16] = "not run";
+		if (s->pid > 0)
+			snprintf(pid, sizeof(pid), "%d", (int)s->pid);
+		if (s->stopped)
+			snprintf(status, sizeof(status), "stopped");
+		else if (s->done && WIFSIGNALED(s->status))
+			snprintf(status, sizeof(status), "signal %d", WTERMSIG(s->status));
+		else if (s->done)
+			snprintf(status, sizeof(status), "exit %d", WEXITSTATUS(s->status));
+
+		double real = s->done ? (s->end.tv_sec - s->start.tv_sec) +
+		                        (s->end.tv_nsec - s->start.tv_nsec) * 1e-9 : 0;
+		fprintf(stderr, "%-3d %7s %-10s %9.3f %9.3f %9.3f  %s%s\n", i + 1, pid, status,
+		        real, seconds(s->ru.ru_utime), seconds(s->ru.ru_stime),
+		        s->node->args[0] ? s->node->args[0] : "", s->thread ? " (builtin)" : "");
+	}
+}
+
+struct reaping {
+	struct stage *stages;
+	int n;
+	int left;		// processes neither reaped nor stopped
+	int stopped;
+	int threads;		// some stage is a builtin thread
+};
+
+static void stage_reaped(void *arg, pid_t pid, int status, const struct rusage *ru)
+{
+	struct reaping *r = (struct reaping *)arg;
+	for (int i = 0; i < r->n; ++i) {
+		if (r->stages[i].pid == pid && WIFSTOPPED(status)) {
+			// a builtin thread is the shell itself, it cannot stop with them
+			if (r->threads) {
+				kill(pid, SIGCONT);
+				break;
+			}
+			r->stages[i].stopped = 1;
+			r->stopped++;
+			r->left--;
+			break;
+		}
+		if (r->stages[i].pid == pid) {
+			clock_gettime(CLOCK_MONOTONIC, &r->stages[i].end);
+			r->stages[i].status = status;
+			r->stages[i].ru = *ru;
+			r->stages[i].done = 1;
+			r->left--;
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Wait for every process of the pipeline, or until ^Z has stopped
+ * all of those left
+ * The event loop reaps the whole group (wait4()) in the order the stages
+ * end, so each one gets its own end time and rusage, and meanwhile keeps
+ * draining the output of background jobs so they don't stall on a full pipe.
+ * @return int number of stopped processes
+ */
+static int reap_pipeline(struct stage *stages, int n, pid_t pgid)
+{
+	struct reaping r = { stages, n, 0, 0, 0 };
+	for (int i = 0; i < n; ++i) {
+		r.left += stages[i].pid > 0 && !stages[i].done;
+		r.threads |= stages[i].thread;
+		stages[i].stopped = 0;
+	}
+	jobs_wait_group(pgid, &r.left, stage_reaped, &r);
+	return r.stopped;
+}
+
+/*
+ * Give the terminal to the pipeline's group while it runs, so ^C and ^Z
+ * go to the commands and not to the shell. A stage that read the terminal
+ * before this got SIGTTIN and stopped: SIGCONT lets it carry on.
+ */
+int terminal_to(pid_t pgid)
+{
+	if (!isatty(STDIN_FILENO) || tcgetpgrp(STDIN_FILENO) != getpgrp())
+		return 0;
+	if (tcsetpgrp(STDIN_FILENO, pgid) < 0)
+		return 0;
+	kill(-pgid, SIGCONT);
+	return 1;
+}
+
 // ======================= requirement 2.4 =======================
 /**
  * @brief 
  * Use "pipe()" to create a communication bridge between processes
- * Call "spawn_proc()" in order according to the number of cmd_node
+ * Call "spawn_proc()" in order according to the number of cmd_node;
+ * builtin stages run in threads (start_builtin())
+ * All processes go into one process group led by the first of them;
+ * every stage is reaped (and threads joined) before returning, unless
+ * the line ended with &: then the group becomes a job (jobs.c) whose
+ * stdin is /dev/null and whose stdout comes back to the shell through
+ * a pipe, unless they were redirected. A pipeline stopped by ^Z becomes
+ * a job as it is.
  * @param cmd Command structure  
  * @return int
  * Return execution status 
@@ -139,43 +501,109 @@ int fork_cmd_node(struct cmd *cmd)
         return -1;
     }
 
+	int n = 0;
+	for (struct cmd_node *p = cur; p != NULL; p = p->next) {
+		// "ls |", "| wc": a stage without a command
+		if (p->length == 0) {
+			fprintf(stderr, "syntax error near unexpected token `|'\n");
+			return -1;
+		}
+		n++;
+	}
+	struct stage *stages = (struct stage *)calloc(n, sizeof(struct stage));
+	if (stages == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
     int prev_read_fd = 0;   // stdin for first command
     int pipefd[2];
+	int ret = 1;
+	pid_t pgid = 0;         // group of the pipeline, set by its first process
+	int own_terminal = 0;
+	int job = 0, job_out[2] = { -1, -1 };
+
+	if (cmd->background) {
+		job = jobs_new(cmd->line, cmd->line_len);
+		if (job < 0 || pipe2(job_out, O_CLOEXEC) < 0) {
+			if (job > 0)
+				perror("pipe error!");
+			free(stages);
+			return -1;
+		}
+		// not the terminal: it stays with the shell
+		if (cur->in_file == NULL)
+			prev_read_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
 
-    while (cur != NULL) {
+	// the threads write through their own FILEs, ours must not follow them
+	fflush(stdout);
+
+    for (int i = 0; cur != NULL; ++i) {
         int write_fd = 1;       // default: stdout
         int next_read_fd = -1;  // read end for next command
 
         // If there is a next command, create a pipe
         if (cur->next != NULL) {
-            if (pipe(pipefd) < 0) {
+            if (pipe2(pipefd, O_CLOEXEC) < 0) {
 				// pipe(pipefd) creates a unidirectional data channel
 				// pipefd[0] = read end
 				// pipefd [1] = write end
                 perror("pipe error!");
-                return -1;
+                ret = -1;
+                break;
             }
             next_read_fd = pipefd[0];  // read side for next command
             write_fd     = pipefd[1];  // write side for current command
+        } else if (job && cur->out_file == NULL) {
+            write_fd = job_out[1];     // output of the job, read by the event loop
+            job_out[1] = -1;           // closed below like any write end
         }
 
         // Tell this node which fds to use
         cur->in  = prev_read_fd;
         cur->out = write_fd;
 
-        // Run this command (child will call redirection() + execvp())
-        if (spawn_proc(cur) < 0) {
-            return -1;
-        }
+		struct stage *s = &stages[i];
+		s->node = cur;
+		s->func = searchBuiltInCommand(cur);
+		clock_gettime(CLOCK_MONOTONIC, &s->start);
+        if (s->func != -1 && !job) {
+            // the thread owns (and closes) both ends it was given
+            start_builtin(s);
+        } else {
+            // Run this command (child will call redirection() + execv())
+            s->pid = s->func != -1 ? fork_builtin(s, pgid) : spawn_proc(cur, pgid, true);
+            if (s->pid < 0) {
+                s->pid = 0;
+                ret = -1;
+            } else if (s->pid == 0) {
+                // never started: like the 127 of a fork child that found nothing
+                s->status = W_EXITCODE(127, 0);
+                s->end = s->start;
+                s->done = 1;
+            } else if (job) {
+                pgid = pgid ? pgid : s->pid;
+                jobs_track(job, s->pid);
+            } else if (pgid == 0) {
+                pgid = s->pid;
+                own_terminal = terminal_to(pgid);
+            }
+
+            // Parent: close write end we just used
+            if (write_fd != 1) {
+                close(write_fd);
+            }
 
-        // Parent: close write end we just used
-        if (write_fd != 1) {
-            close(write_fd);
+            // Parent: close previous read end (no longer needed)
+            if (prev_read_fd != 0 && prev_read_fd != -1) {
+                close(prev_read_fd);
+            }
         }
 
-        // Parent: close previous read end (no longer needed)
-        if (prev_read_fd != 0 && prev_read_fd != -1) {
-            close(prev_read_fd);
+        if (ret < 0) {
+            prev_read_fd = next_read_fd;
+            break;
         }
 
         // Prepare for next command
@@ -188,34 +616,111 @@ int fork_cmd_node(struct cmd *cmd)
         close(prev_read_fd);
     }
 
-    return 1;
+	if (job) {
+		if (job_out[1] >= 0)
+			close(job_out[1]);	// never handed to a stage
+		jobs_start(job, job_out[0]);
+		free(stages);
+		return ret;
+	}
+
+	int stopped = pgid != 0 ? reap_pipeline(stages, n, pgid) : 0;
+	// ^Z: the pipeline becomes a job for fg; with no free job it carries on
+	while (stopped > 0 && jobs_add_stopped(cmd->line, cmd->line_len, pgid, stopped,
+	                                       stages[n - 1].pid, stages[n - 1].status) < 0) {
+		kill(-pgid, SIGCONT);
+		stopped = reap_pipeline(stages, n, pgid);
+	}
+	for (int i = 0; i < n; ++i) {
+		if (stages[i].thread) {
+			pthread_join(stages[i].tid, NULL);
+			stages[i].done = 1;
+		}
+	}
+	// take the terminal back; SIGTTOU is ignored, we are not in the foreground group
+	if (own_terminal)
+		tcsetpgrp(STDIN_FILENO, getpgrp());
+
+	if (report_stages)
+		report_pipeline(stages, n);
+	free(stages);
+    return ret;
 }
 
 // ===============================================================
 
 
-void shell()
+/**
+ * @brief Run the commands read from input until it ends or exit
+ * 
+ * @param input Where the lines come from, owned by the caller
+ * @param interactive Print a prompt and keep a history; a script
+ * (my_shell file, my_shell -c) does neither
+ */
+void shell(struct line_reader *input, bool interactive)
 {
+	struct arena arena = { 0 };	// everything split_line() builds for one line, reused
+	bool prompt = interactive;
+	// commands run in their own process group; tcsetpgrp() back to us
+	// from outside the foreground group would otherwise stop the shell,
+	// and ^Z at the prompt must not stop it either
+	if (isatty(STDIN_FILENO)) {
+		signal(SIGTTOU, SIG_IGN);
+		signal(SIGTSTP, SIG_IGN);
+	}
+	if (jobs_init() < 0)
+		exit(1);
 	while (1) {
-		printf(">>> $ ");
-		char *buffer = read_line();
-		if (buffer == NULL)
+		if (prompt) {
+			// "Done" lines of background jobs come before the prompt
+			jobs_poll(0, -1);
+			printf(">>> $ ");
+			fflush(stdout);
+			prompt = false;
+		}
+		size_t len, unread = input->end - input->start;
+		const char *buffer = read_line(input, &len);
+		if (buffer == NULL) {
+			// only blank lines went by (Enter at the prompt): prompt again
+			if (interactive && input->end - input->start != unread) {
+				prompt = true;
+				continue;
+			}
+			if (input->eof) {
+				// end of input: let the background jobs finish first
+				jobs_wait(0);
+				break;
+			}
+			// sleep until the input has more, meanwhile serve the jobs
+			if (jobs_poll(-1, input->fd) && fill_line(input) < 0) {
+				perror("Unable to read line");
+				break;
+			}
 			continue;
+		}
+		prompt = interactive;
+		if (interactive)
+			record_line(buffer, len);
 
-		struct cmd *cmd = split_line(buffer);
+		struct cmd *cmd = split_line(buffer, len, &arena);
 		
 		int status = -1;
 		// only a single command
 		struct cmd_node *temp = cmd->head;
 		
-		if(temp->next == NULL){
+		if (temp->length == 0 && temp->next == NULL) {
+			// nothing to run ("&", "< file")
+		}
+		else if(temp->next == NULL && !cmd->background){
 			status = searchBuiltInCommand(temp);
 			if (status != -1){
 				int in = dup(STDIN_FILENO), out = dup(STDOUT_FILENO);
 				if( in == -1 || out == -1)
 					perror("dup");
 				redirection(temp);
-				status = execBuiltInCommand(status,temp);
+				status = execBuiltInCommand(status, temp, stdin, stdout);
+				// before stdout points back at the terminal
+				fflush(stdout);
 
 				// recover shell stdin and stdout
 				if (temp->in_file)  dup2(in, 0);
@@ -226,27 +731,23 @@ void shell()
 				close(out);
 			}
 			else{
-				//external command
-				status = spawn_proc(cmd->head);
+				//external command: a pipeline of one
+				status = fork_cmd_node(cmd);
 			}
 		}
-		// There are multiple commands ( | )
+		// There are multiple commands ( | ), or a background job ( & )
 		else{
 			
 			status = fork_cmd_node(cmd);
 		}
-		// free space
-		while (cmd->head) {
-			
-			struct cmd_node *temp = cmd->head;
-      		cmd->head = cmd->head->next;
-			free(temp->args);
-   	    	free(temp);
-   		}
-		free(cmd);
-		free(buffer);
+		// free space: the whole parse goes at once (buffer belongs to input)
+		arena_reset(&arena);
 		
-		if (status == 0)
+		if (status == 0) {
+			// exit: same as end of input, background jobs finish first
+			jobs_wait(0);
 			break;
+		}
 	}
+	arena_free(&arena);
 }